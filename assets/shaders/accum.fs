@@ -0,0 +1,12 @@
+#version 330 core
+
+in vec2 fragTexCoord;
+
+out vec4 FragColor;
+
+uniform sampler2D texture0;
+uniform float u_weight; // Share of this sample in the final frame
+
+void main() {
+    FragColor = texture(texture0, fragTexCoord) * u_weight;
+}
@@ -3,6 +3,7 @@
 // Uniforms for resolution and time (passed from Raylib)
 uniform vec2 resolution;
 uniform float time;
+uniform vec2 tileOffset; // Position of the rendered tile within the frame
 uniform sampler2D texture1;
 
 // Input from vertex shader
@@ -52,7 +53,7 @@ mat3 calcLookAtMatrix(vec3 ro, vec3 ta, float roll) {
 
 void main() {
     // Adjust UV coordinates to match Shadertoy behavior
-    vec2 uv = gl_FragCoord.xy / resolution.y;
+    vec2 uv = (gl_FragCoord.xy + tileOffset) / resolution.y;
     uv -= vec2(0.5 * resolution.x / resolution.y, 0.5);
     uv.y *= -1.0;
 
@@ -4,6 +4,7 @@ out vec4 FragColor;
 
 uniform float u_time;
 uniform vec2 u_resolution;
+uniform vec2 u_tile_offset; // Position of the rendered tile within the frame
 
 vec3 palette( float t ) {
     vec3 a = vec3(0.5, 0.5, 0.5);
@@ -15,7 +16,7 @@ vec3 palette( float t ) {
 }
 
 void main() {
-    vec2 fragCoord = gl_FragCoord.xy;
+    vec2 fragCoord = gl_FragCoord.xy + u_tile_offset;
     vec2 uv = (fragCoord*2 - u_resolution.xy) / u_resolution.y;
     vec2 uv0 = uv;
     vec3 finalColor = vec3(0.0);
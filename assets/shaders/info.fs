@@ -5,10 +5,11 @@ out vec4 FragColor;
 uniform float u_time;
 uniform vec2 u_resolution; // Rectangle size
 uniform vec2 u_origin;     // Bottom-left corner of rectangle in window space
+uniform vec2 u_tile_offset; // Position of the rendered tile within the window
 
 void main() {
     // Convert fragment coordinates to local rectangle space
-    vec2 fragCoord = gl_FragCoord.xy;
+    vec2 fragCoord = gl_FragCoord.xy + u_tile_offset;
     vec2 localCoord = fragCoord - u_origin;
     vec2 normCoord = localCoord / u_resolution;      // [0, 1]
     vec2 uv = normCoord * 2.0 - 1.0;                  // [-1, 1]
@@ -12,7 +12,7 @@ uniform float dt;
 // Output fragment color
 out vec4 finalColor;
 
-float ra = 21.0;
+uniform float ra = 21.0; // Set from SMOOTHLIFE_RADIUS
 float b1 = 0.257;
 float b2 = 0.336;
 float d1 = 0.365;
@@ -55,9 +55,11 @@ void main() {
     float n = 0.0;
     float N = PI * ra * ra - M;
 
-    // Sample in a circular region
-    for (float dy = -ra; dy <= ra; dy += 1.0) {
-        for (float dx = -ra; dx <= ra; dx += 1.0) {
+    // Sample in a circular region of whole cells, the same floor(ra) cells
+    // the CPU backends visit, so a fractional radius does not shift the offsets
+    float r = floor(ra);
+    for (float dy = -r; dy <= r; dy += 1.0) {
+        for (float dx = -r; dx <= r; dx += 1.0) {
             float x = cx + dx;
             float y = cy + dy;
             float dist_sq = dx * dx + dy * dy;
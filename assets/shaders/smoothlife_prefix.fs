@@ -0,0 +1,23 @@
+#version 330 core
+
+// One pass of an inclusive prefix sum along the rows (Hillis-Steele):
+// after the passes with strides 1, 2, 4, ... every texel holds the sum of
+// its row up to and including itself.
+
+out vec4 finalColor;
+
+uniform sampler2D texture0;
+uniform int u_stride;
+uniform bool u_first; // The first pass reads the single channel state (sampled as RRR1) instead of a previous pass
+
+float value(ivec2 p) {
+    vec4 texColor = texelFetch(texture0, p, 0);
+    return u_first ? max(max(texColor.x, texColor.y), texColor.z) : texColor.x;
+}
+
+void main() {
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    float sum = value(p);
+    if (p.x >= u_stride) sum += value(ivec2(p.x - u_stride, p.y));
+    finalColor = vec4(sum, 0.0, 0.0, 1.0);
+}
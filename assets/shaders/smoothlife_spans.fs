@@ -0,0 +1,87 @@
+#version 330 core
+
+// Input uniform values
+uniform sampler2D texture0;
+uniform sampler2D u_prefix; // Inclusive prefix sums of the rows of texture0, see smoothlife_prefix.fs
+uniform vec2 resolution;
+uniform float dt;
+
+// Output fragment color
+out vec4 finalColor;
+
+uniform float ra = 21.0; // Set from SMOOTHLIFE_RADIUS
+float b1 = 0.257;
+float b2 = 0.336;
+float d1 = 0.365;
+float d2 = 0.549;
+float alpha_n = 0.028;
+float alpha_m = 0.147;
+
+#define PI 3.14159265359
+
+float sigma(float x, float a, float alpha) {
+    return 1.0 / (1.0 + exp(-(x - a) * 4.0 / alpha));
+}
+
+float sigma_n(float x, float a, float b) {
+    return sigma(x, a, alpha_n) * (1.0 - sigma(x, b, alpha_n));
+}
+
+float sigma_m(float x, float y, float m) {
+    return x * (1.0 - sigma(m, 0.5, alpha_m)) + y * sigma(m, 0.5, alpha_m);
+}
+
+float s(float n, float m) {
+    return sigma_n(n, sigma_m(b1, d1, m), sigma_m(b2, d2, m));
+}
+
+// Half width of the row dy of the disk, the same cells as dx*dx + dy*dy <= radius_sq
+int extent(float radius_sq, float dy) {
+    float dy_sq = dy * dy;
+    if (dy_sq > radius_sq) return -1;
+    int e = int(sqrt(radius_sq - dy_sq));
+    if (float((e + 1) * (e + 1)) + dy_sq <= radius_sq) e += 1;
+    if (float(e * e) + dy_sq > radius_sq) e -= 1;
+    return e;
+}
+
+// Prefix sum up to and including x for any x, continued periodically past the edges
+float prefix(int x, int y, int width, float total) {
+    int wraps = x >= 0 ? x / width : -((-x - 1) / width) - 1;
+    return texelFetch(u_prefix, ivec2(x - wraps * width, y), 0).x + float(wraps) * total;
+}
+
+float span(int cx, int e, int y, int width, float total) {
+    return prefix(cx + e, y, width, total) - prefix(cx - e - 1, y, width, total);
+}
+
+void main() {
+    // The same cells as smoothlife.fs, but every row of the disk is a single
+    // span of the prefix sums instead of 2*ra + 1 texel fetches
+    ivec2 c = ivec2(gl_FragCoord.xy);
+    ivec2 size = ivec2(resolution);
+
+    float ri = ra / 3.0;
+    float m = 0.0;
+    float M = PI * ri * ri;
+    float n = 0.0;
+    float N = PI * ra * ra - M;
+
+    for (float dy = -floor(ra); dy <= ra; dy += 1.0) {
+        // Positive modulo, the radius may exceed the height
+        int y = ((c.y + int(dy)) % size.y + size.y) % size.y;
+        float total = texelFetch(u_prefix, ivec2(size.x - 1, y), 0).x;
+        int outer = extent(ra * ra, dy);
+        int inner = extent(ri * ri, dy);
+        float inner_sum = inner >= 0 ? span(c.x, inner, y, size.x, total) : 0.0;
+        m += inner_sum;
+        n += span(c.x, outer, y, size.x, total) - inner_sum;
+    }
+    m /= M;
+    n /= N;
+    float q = s(n, m);
+    float diff = 2.0 * q - 1.0;
+    vec4 texColor = texelFetch(texture0, c, 0);
+    float v = clamp(max(max(texColor.x, texColor.y), texColor.z) + dt * diff, 0.0, 1.0);
+    finalColor = vec4(v, v, v, 1.0);
+}
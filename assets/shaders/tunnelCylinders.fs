@@ -3,6 +3,7 @@
 
 uniform vec2 resolution;
 uniform float time;
+uniform vec2 tileOffset; // Position of the rendered tile within the frame
 
 out vec4 fragColor;
 
@@ -89,7 +90,7 @@ vec2 march(vec3 pos, vec3 dir) {
 
 void main() {
     h = vec3(0.0);
-    vec2 uv = (gl_FragCoord.xy - 0.5 * resolution.xy) / resolution.y;
+    vec2 uv = (gl_FragCoord.xy + tileOffset - 0.5 * resolution.xy) / resolution.y;
     vec3 dir = camera(uv);
     vec3 pos = vec3(0.0, 0.0, 4.5 - time * 2.0);
 
@@ -17,7 +17,10 @@ void libs(Nob_Cmd *cmd) {
 	nob_cmd_append(cmd, "-l:libraylib.so", "-lm", "-ldl", "-lpthread");
 }
 
-bool build_plug_c(bool force, Nob_Cmd *cmd, const char *source_path, const char *output_path) {
+// Profiler shared by main and the plugins, see src/trace.h
+bool build_trace(bool force, Nob_Cmd *cmd) {
+	const char *output_path = BUILD_DIR"libtrace.so";
+	const char *source_path = SRC_DIR"/trace.c";
 	int rebuild_is_needed = nob_needs_rebuild1(output_path, source_path);
 	if (rebuild_is_needed < 0) return false;
 
@@ -35,11 +38,57 @@ bool build_plug_c(bool force, Nob_Cmd *cmd, const char *source_path, const char
 	return true;
 }
 
+// flags are appended after the libraries, e.g. optimizations or extra libraries
+bool build_plug(bool force, Nob_Cmd *cmd, const char **input_paths, size_t input_paths_len, const char *output_path, const char **flags, size_t flags_len) {
+	int rebuild_is_needed = nob_needs_rebuild(output_path, input_paths, input_paths_len);
+	if (rebuild_is_needed < 0) return false;
+
+	if (force || rebuild_is_needed) {
+		cmd->count = 0;
+		cc(cmd);
+		nob_cmd_append(cmd, "-fPIC", "-shared", "-Wl,--no-undefined");
+		nob_cmd_append(cmd, "-o", output_path);
+		nob_da_append_many(cmd, input_paths, input_paths_len);
+		libs(cmd);
+		nob_cmd_append(cmd, "-L"BUILD_DIR, "-ltrace");
+		nob_da_append_many(cmd, flags, flags_len);
+		return nob_cmd_run_sync(*cmd);
+	}
+
+	nob_log(NOB_INFO, "%s is up-to-date", output_path);
+	return true;
+}
+
+bool build_plug_c(bool force, Nob_Cmd *cmd, const char *source_path, const char *output_path) {
+	return build_plug(force, cmd, &source_path, 1, output_path, NULL, 0);
+}
+
+// SmoothLife also simulates on the CPU, which is only usable with optimizations,
+// and sets up its single channel state textures with plain GL
+bool build_smoothlife(bool force, Nob_Cmd *cmd) {
+	const char *input_paths[] = {
+		SRC_DIR"/smoothlife.c",
+		SRC_DIR"/smoothlife_cpu.c",
+		SRC_DIR"/fft.c",
+		SRC_DIR"/thread_pool.c"
+	};
+	const char *flags[] = { "-O2", "-lGL" };
+	return build_plug(force, cmd, input_paths, NOB_ARRAY_LEN(input_paths), BUILD_DIR"libsmoothlife.so", flags, NOB_ARRAY_LEN(flags));
+}
+
 bool build_main(bool force, Nob_Cmd *cmd) {
 	const char *output_path = BUILD_DIR"main";
 	const char *input_paths[] = {
 		SRC_DIR"/main.c",
-		SRC_DIR"/ffmpeg_linux.c"
+		SRC_DIR"/ffmpeg_linux.c",
+		SRC_DIR"/readback.c",
+		SRC_DIR"/render_stats.c",
+		SRC_DIR"/tiled.c",
+		SRC_DIR"/png_stream.c",
+		SRC_DIR"/capture_pool.c",
+		SRC_DIR"/accum.c",
+		SRC_DIR"/yuv.c",
+		SRC_DIR"/thread_pool.c"
 	};
 	size_t input_paths_len = NOB_ARRAY_LEN(input_paths);
 
@@ -52,7 +101,56 @@ bool build_main(bool force, Nob_Cmd *cmd) {
 		nob_cmd_append(cmd, "-o", output_path);
 		nob_da_append_many(cmd, input_paths, input_paths_len);
 		libs(cmd);
+		nob_cmd_append(cmd, "-L"BUILD_DIR, "-ltrace", "-lGL", "-lz");
+
+		return nob_cmd_run_sync(*cmd);
+	}
+
+	nob_log(NOB_INFO, "%s is up-to-date", output_path);
+	return true;
+}
+
+// Headless frame time benchmark of the plugins, see src/bench.c
+bool build_bench(bool force, Nob_Cmd *cmd) {
+	const char *output_path = BUILD_DIR"bench";
+	const char *source_path = SRC_DIR"/bench.c";
+	int rebuild_is_needed = nob_needs_rebuild1(output_path, source_path);
+	if (rebuild_is_needed < 0) return false;
+
+	if (force || rebuild_is_needed) {
+		cmd->count = 0;
+		cc(cmd);
+		nob_cmd_append(cmd, "-o", output_path);
+		nob_cmd_append(cmd, source_path);
+		libs(cmd);
+		nob_cmd_append(cmd, "-lGL");
+		return nob_cmd_run_sync(*cmd);
+	}
+
+	nob_log(NOB_INFO, "%s is up-to-date", output_path);
+	return true;
+}
 
+// Golden-image regression check of the plugins, see src/golden.c
+bool build_golden(bool force, Nob_Cmd *cmd) {
+	const char *output_path = BUILD_DIR"golden";
+	const char *input_paths[] = {
+		SRC_DIR"/golden.c",
+		SRC_DIR"/image_diff.c",
+		SRC_DIR"/thread_pool.c"
+	};
+	size_t input_paths_len = NOB_ARRAY_LEN(input_paths);
+
+	int rebuild_is_needed = nob_needs_rebuild(output_path, input_paths, input_paths_len);
+	if (rebuild_is_needed < 0) return false;
+
+	if (force || rebuild_is_needed) {
+		cmd->count = 0;
+		cc(cmd);
+		nob_cmd_append(cmd, "-o", output_path);
+		nob_da_append_many(cmd, input_paths, input_paths_len);
+		libs(cmd);
+		nob_cmd_append(cmd, "-L"BUILD_DIR, "-ltrace");
 		return nob_cmd_run_sync(*cmd);
 	}
 
@@ -67,10 +165,20 @@ int main(int argc, char **argv) {
 	(void) program_name;
 
 	bool force = false;
+	bool bench = false;
+	bool golden = false;
 	while (argc > 0) {
 		const char *flag = nob_shift_args(&argc, &argv);
 		if (strcmp(flag, "-f") == 0) {
 			force = true;
+		} else if (strcmp(flag, "bench") == 0) {
+			// Everything after `bench` is passed to ./build/bench
+			bench = true;
+			break;
+		} else if (strcmp(flag, "golden") == 0) {
+			// Everything after `golden` is passed to ./build/golden
+			golden = true;
+			break;
 		} else {
 			nob_log(NOB_ERROR, "Unknown flag %s", flag);
 			return 1;
@@ -80,12 +188,29 @@ int main(int argc, char **argv) {
 	if (!nob_mkdir_if_not_exists(BUILD_DIR)) return 1;
 
 	Nob_Cmd cmd = {0};
+	if (!build_trace(force, &cmd)) return 1;
 	if (!build_plug_c(force, &cmd, SRC_DIR"/example.c", BUILD_DIR"libexample.so")) return 1;
     if (!build_plug_c(force, &cmd, SRC_DIR"/growin.c", BUILD_DIR"libgrowin.so")) return 1;
-	if (!build_plug_c(force, &cmd, SRC_DIR"/smoothlife.c", BUILD_DIR"libsmoothlife.so")) return 1;
+	if (!build_smoothlife(force, &cmd)) return 1;
 	if (!build_plug_c(force, &cmd, SRC_DIR"/tunnelcylinder.c", BUILD_DIR"libtunnelcylinder.so")) return 1;
 	if (!build_plug_c(force, &cmd, SRC_DIR"/dragonball.c", BUILD_DIR"libdragonball.so")) return 1;
 	if (!build_main(force, &cmd)) return 1;
+	if (!build_bench(force, &cmd)) return 1;
+	if (!build_golden(force, &cmd)) return 1;
+
+	if (bench) {
+		cmd.count = 0;
+		nob_cmd_append(&cmd, BUILD_DIR"bench");
+		nob_da_append_many(&cmd, argv, argc);
+		if (!nob_cmd_run_sync(cmd)) return 1;
+	}
+
+	if (golden) {
+		cmd.count = 0;
+		nob_cmd_append(&cmd, BUILD_DIR"golden");
+		nob_da_append_many(&cmd, argv, argc);
+		if (!nob_cmd_run_sync(cmd)) return 1;
+	}
 
 	// cmd.count = 0;
 	// nob_cmd_append(&cmd, BUILD_DIR"main", BUILD_DIR"libexample.so");
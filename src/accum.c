@@ -0,0 +1,112 @@
+#include <assert.h>
+#include <stdlib.h>
+
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+#include <raylib.h>
+#include <rlgl.h>
+#include "accum.h"
+#include "trace.h"
+
+struct Accum {
+    size_t width;
+    size_t height;
+    size_t samples;
+    size_t subframes;
+    // RGBA32F sum of the weighted samples
+    RenderTexture2D sum;
+    Shader shader;
+    int weight_loc;
+};
+
+// Low discrepancy sub-pixel offsets in [-0.5, 0.5)
+static float accum_halton(size_t index, size_t base) {
+    float result = 0.0f;
+    float fraction = 1.0f;
+    for (index += 1; index > 0; index /= base) {
+        fraction /= base;
+        result += fraction * (index % base);
+    }
+    return result - 0.5f;
+}
+
+Accum *accum_start(size_t width, size_t height, size_t samples, size_t subframes) {
+    Accum *accum = calloc(1, sizeof(Accum));
+    assert(accum != NULL && "Buy MORE RAM lol!!");
+    accum->width = width;
+    accum->height = height;
+    accum->samples = samples > 0 ? samples : 1;
+    accum->subframes = subframes > 0 ? subframes : 1;
+
+    RenderTexture2D sum = {0};
+    sum.id = rlLoadFramebuffer();
+    sum.texture.id = rlLoadTexture(NULL, width, height, PIXELFORMAT_UNCOMPRESSED_R32G32B32A32, 1);
+    sum.texture.width = width;
+    sum.texture.height = height;
+    sum.texture.mipmaps = 1;
+    sum.texture.format = PIXELFORMAT_UNCOMPRESSED_R32G32B32A32;
+    rlFramebufferAttach(sum.id, sum.texture.id, RL_ATTACHMENT_COLOR_CHANNEL0, RL_ATTACHMENT_TEXTURE2D, 0);
+    if (!rlFramebufferComplete(sum.id)) {
+        TraceLog(LOG_WARNING, "ACCUM: float render targets are not supported, summing up in 8 bits");
+        rlUnloadFramebuffer(sum.id);
+        rlUnloadTexture(sum.texture.id);
+        sum = LoadRenderTexture(width, height);
+    }
+    accum->sum = sum;
+
+    accum->shader = LoadShader(0, "./assets/shaders/accum.fs");
+    accum->weight_loc = GetShaderLocation(accum->shader, "u_weight");
+    return accum;
+}
+
+void accum_end(Accum *accum) {
+    UnloadShader(accum->shader);
+    UnloadRenderTexture(accum->sum);
+    free(accum);
+}
+
+void accum_render(Accum *accum, RenderTexture2D target, float dt, Accum_Draw draw, void *user) {
+    TRACE_SCOPE("accum_render");
+    size_t passes = accum->samples * accum->subframes;
+    float weight = 1.0f / passes;
+    Rectangle source = { 0, 0, accum->width, -(float)accum->height };
+
+    BeginTextureMode(accum->sum);
+    ClearBackground(BLANK);
+    EndTextureMode();
+
+    for (size_t pass = 0; pass < passes; ++pass) {
+        size_t sample = pass % accum->samples;
+        float jitter_x = accum->samples > 1 ? accum_halton(sample, 2) : 0.0f;
+        float jitter_y = accum->samples > 1 ? accum_halton(sample, 3) : 0.0f;
+
+        BeginTextureMode(target);
+        // Moving the frame by -jitter samples every pixel at its center + jitter
+        rlMatrixMode(RL_PROJECTION);
+        rlLoadIdentity();
+        rlOrtho(jitter_x, accum->width + jitter_x, accum->height + jitter_y, jitter_y, 0.0f, 1.0f);
+        rlMatrixMode(RL_MODELVIEW);
+        rlLoadIdentity();
+        // Time only moves on with the first sample of every subframe
+        draw(user, accum->width, accum->height, jitter_x, -jitter_y, sample == 0 ? dt / accum->subframes : 0.0f);
+        EndTextureMode();
+
+        BeginTextureMode(accum->sum);
+        BeginShaderMode(accum->shader);
+        SetShaderValue(accum->shader, accum->weight_loc, &weight, SHADER_UNIFORM_FLOAT);
+        BeginBlendMode(BLEND_ADD_COLORS);
+        DrawTextureRec(target.texture, source, (Vector2){0}, WHITE);
+        EndBlendMode();
+        EndShaderMode();
+        EndTextureMode();
+    }
+
+    // Resolve straight into the 8 bit target that gets read back
+    rlBindFramebuffer(RL_READ_FRAMEBUFFER, accum->sum.id);
+    rlBindFramebuffer(RL_DRAW_FRAMEBUFFER, target.id);
+    glBlitFramebuffer(0, 0, accum->width, accum->height, 0, 0, accum->width, accum->height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    rlBindFramebuffer(RL_READ_FRAMEBUFFER, 0);
+    rlBindFramebuffer(RL_DRAW_FRAMEBUFFER, 0);
+}
@@ -0,0 +1,24 @@
+#ifndef ACCUM_H_
+#define ACCUM_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include <raylib.h>
+
+// Draws one sample of the width x height frame. The projection is already
+// shifted by the sub-pixel jitter, jitter_x/jitter_y is the same shift for
+// gl_FragCoord (counted from the bottom left). dt advances the animation.
+typedef void (*Accum_Draw)(void *user, size_t width, size_t height, float jitter_x, float jitter_y, float dt);
+
+// Anti-aliasing by accumulation: every frame is drawn `samples` times with
+// jittered sub-pixel offsets for each of `subframes` points in time (motion
+// blur), summed up in a float render target and resolved once.
+typedef struct Accum Accum;
+
+Accum *accum_start(size_t width, size_t height, size_t samples, size_t subframes);
+void accum_end(Accum *accum);
+// Renders a frame advancing the animation by dt into target, which has to be width x height
+void accum_render(Accum *accum, RenderTexture2D target, float dt, Accum_Draw draw, void *user);
+
+#endif // ACCUM_H_
@@ -0,0 +1,295 @@
+// Headless benchmark of the plugins: renders a fixed amount of frames of every
+// plugin at several resolutions into an offscreen render texture and reports
+// the frame time distribution as CSV or JSON. glFinish() after every frame
+// makes the timings include the GPU work, so the numbers are meaningful under
+// a software driver too (LIBGL_ALWAYS_SOFTWARE=1 on Mesa picks llvmpipe).
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+
+#include "raylib.h"
+
+#include <dlfcn.h>
+#include <GL/gl.h>
+
+#define NOB_IMPLEMENTATION
+#include "nob.h"
+#include "plug.h"
+
+#define BENCH_DEFAULT_FRAMES 300
+// Frames rendered before measuring, shader compilation and first uploads are not interesting
+#define BENCH_WARMUP_FRAMES 10
+#define BENCH_FPS 60
+#define BENCH_PLUG_DIR "./build/"
+
+typedef struct {
+    size_t width;
+    size_t height;
+} Bench_Size;
+
+typedef struct {
+    Bench_Size *items;
+    size_t count;
+    size_t capacity;
+} Bench_Sizes;
+
+typedef struct {
+    const char *plug;
+    Bench_Size size;
+    size_t frames;
+    double min, median, p95, p99, max;  // Frame times in milliseconds
+    double total;                       // Seconds spent on the measured frames
+} Bench_Result;
+
+typedef struct {
+    Bench_Result *items;
+    size_t count;
+    size_t capacity;
+} Bench_Results;
+
+static void *libplug = NULL;
+
+// Keeps stdout clean for the report
+static void log_to_stderr(int log_level, const char *text, va_list args) {
+    (void)log_level;
+    vfprintf(stderr, text, args);
+    fprintf(stderr, "\n");
+}
+
+static bool load_libplug(const char *libplug_path) {
+    if (libplug != NULL) {
+        dlclose(libplug);
+    }
+
+    libplug = dlopen(libplug_path, RTLD_NOW);
+    if (libplug == NULL) {
+        fprintf(stderr, "ERROR: %s\n", dlerror());
+        return false;
+    }
+
+    #define PLUG(name, ...) \
+        name = dlsym(libplug, #name); \
+        if (name == NULL) { \
+            fprintf(stderr, "ERROR: %s\n", dlerror()); \
+            return false; \
+        }
+    LIST_OF_PLUGS
+    #undef PLUG
+
+    return true;
+}
+
+// Gives the plugin's GPU resources and state back before the next one is loaded
+static void unload_libplug(void) {
+    if (libplug == NULL) return;
+    free(plug_pre_reload());
+    dlclose(libplug);
+    libplug = NULL;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of sorted samples
+static double percentile(const double *sorted, size_t count, double p) {
+    size_t rank = (size_t)(p / 100.0 * count + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > count) rank = count;
+    return sorted[rank - 1];
+}
+
+static void render_frame(RenderTexture2D target, Bench_Size size) {
+    BeginTextureMode(target);
+    plug_update(1.0f/BENCH_FPS, size.width, size.height, true);
+    EndTextureMode();
+    glFinish();
+}
+
+static Bench_Result bench_plug(const char *plug, Bench_Size size, size_t frames, double *samples) {
+    RenderTexture2D target = LoadRenderTexture(size.width, size.height);
+    plug_reset();
+    for (size_t i = 0; i < BENCH_WARMUP_FRAMES; ++i) render_frame(target, size);
+
+    Bench_Result result = { .plug = plug, .size = size, .frames = frames };
+    for (size_t i = 0; i < frames; ++i) {
+        double start = GetTime();
+        render_frame(target, size);
+        samples[i] = (GetTime() - start) * 1000.0;
+        result.total += samples[i] / 1000.0;
+    }
+    UnloadRenderTexture(target);
+
+    qsort(samples, frames, sizeof(*samples), compare_doubles);
+    result.min = samples[0];
+    result.median = percentile(samples, frames, 50);
+    result.p95 = percentile(samples, frames, 95);
+    result.p99 = percentile(samples, frames, 99);
+    result.max = samples[frames - 1];
+    return result;
+}
+
+static void report_csv(FILE *f, Bench_Results results) {
+    fprintf(f, "plug,width,height,frames,min_ms,median_ms,p95_ms,p99_ms,max_ms,fps\n");
+    for (size_t i = 0; i < results.count; ++i) {
+        Bench_Result *r = &results.items[i];
+        fprintf(f, "%s,%zu,%zu,%zu,%.3f,%.3f,%.3f,%.3f,%.3f,%.2f\n",
+                r->plug, r->size.width, r->size.height, r->frames,
+                r->min, r->median, r->p95, r->p99, r->max, r->frames / r->total);
+    }
+}
+
+static void report_json(FILE *f, Bench_Results results) {
+    fprintf(f, "[\n");
+    for (size_t i = 0; i < results.count; ++i) {
+        Bench_Result *r = &results.items[i];
+        fprintf(f, "    {\"plug\": \"%s\", \"width\": %zu, \"height\": %zu, \"frames\": %zu, "
+                   "\"min_ms\": %.3f, \"median_ms\": %.3f, \"p95_ms\": %.3f, \"p99_ms\": %.3f, \"max_ms\": %.3f, \"fps\": %.2f}%s\n",
+                r->plug, r->size.width, r->size.height, r->frames,
+                r->min, r->median, r->p95, r->p99, r->max, r->frames / r->total,
+                i + 1 < results.count ? "," : "");
+    }
+    fprintf(f, "]\n");
+}
+
+static int compare_paths(const void *a, const void *b) {
+    return strcmp(*(const char**)a, *(const char**)b);
+}
+
+// Every lib*.so in the build directory that exports the plugin interface
+static bool find_plugs(Nob_File_Paths *plugs) {
+    Nob_File_Paths children = {0};
+    if (!nob_read_entire_dir(BENCH_PLUG_DIR, &children)) return false;
+    for (size_t i = 0; i < children.count; ++i) {
+        const char *name = children.items[i];
+        if (strncmp(name, "lib", 3) != 0 || !nob_sv_end_with(nob_sv_from_cstr(name), ".so")) continue;
+        const char *path = nob_temp_sprintf(BENCH_PLUG_DIR"%s", name);
+        void *lib = dlopen(path, RTLD_LAZY);
+        if (lib == NULL) continue;
+        if (dlsym(lib, "plug_update") != NULL) nob_da_append(plugs, path);
+        dlclose(lib);
+    }
+    qsort(plugs->items, plugs->count, sizeof(*plugs->items), compare_paths);
+    return true;
+}
+
+static void usage(const char *program_name) {
+    fprintf(stderr, "Usage: %s [OPTIONS] [libplug.so...]\n", program_name);
+    fprintf(stderr, "Benchmarks every plugin in "BENCH_PLUG_DIR" unless some are given.\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "    --frames <count>         Measured frames per plugin and size (default: %d)\n", BENCH_DEFAULT_FRAMES);
+    fprintf(stderr, "    --size <width>x<height>  Resolution to render at, can be repeated (default: 1280x720, 1920x1080, 3840x2160)\n");
+    fprintf(stderr, "    --format csv|json        Report format (default: csv)\n");
+    fprintf(stderr, "    --output <path>          Write the report into <path> instead of stdout\n");
+}
+
+int main(int argc, char **argv) {
+    const char *program_name = nob_shift_args(&argc, &argv);
+
+    size_t frames = BENCH_DEFAULT_FRAMES;
+    Bench_Sizes sizes = {0};
+    bool json = false;
+    const char *output_path = NULL;
+    while (argc > 0 && strncmp(argv[0], "--", 2) == 0) {
+        const char *flag = nob_shift_args(&argc, &argv);
+        if (argc <= 0) {
+            usage(program_name);
+            fprintf(stderr, "ERROR: no value is provided for %s\n", flag);
+            return 1;
+        }
+        const char *value = nob_shift_args(&argc, &argv);
+
+        if (strcmp(flag, "--frames") == 0) {
+            frames = strtoul(value, NULL, 10);
+            if (frames == 0) {
+                fprintf(stderr, "ERROR: invalid frame count %s\n", value);
+                return 1;
+            }
+        } else if (strcmp(flag, "--size") == 0) {
+            Bench_Size size = {0};
+            if (sscanf(value, "%zux%zu", &size.width, &size.height) != 2 || size.width == 0 || size.height == 0) {
+                fprintf(stderr, "ERROR: invalid size %s, expected <width>x<height>\n", value);
+                return 1;
+            }
+            nob_da_append(&sizes, size);
+        } else if (strcmp(flag, "--format") == 0) {
+            if (strcmp(value, "csv") == 0) {
+                json = false;
+            } else if (strcmp(value, "json") == 0) {
+                json = true;
+            } else {
+                fprintf(stderr, "ERROR: unknown format %s, expected csv or json\n", value);
+                return 1;
+            }
+        } else if (strcmp(flag, "--output") == 0) {
+            output_path = value;
+        } else {
+            usage(program_name);
+            fprintf(stderr, "ERROR: unknown option %s\n", flag);
+            return 1;
+        }
+    }
+
+    if (sizes.count == 0) {
+        nob_da_append(&sizes, ((Bench_Size){1280, 720}));
+        nob_da_append(&sizes, ((Bench_Size){1920, 1080}));
+        nob_da_append(&sizes, ((Bench_Size){3840, 2160}));
+    }
+
+    Nob_File_Paths plugs = {0};
+    while (argc > 0) nob_da_append(&plugs, nob_shift_args(&argc, &argv));
+    if (plugs.count == 0 && !find_plugs(&plugs)) return 1;
+    if (plugs.count == 0) {
+        fprintf(stderr, "ERROR: no plugins found in "BENCH_PLUG_DIR"\n");
+        return 1;
+    }
+
+    SetTraceLogCallback(log_to_stderr);
+    SetTraceLogLevel(LOG_WARNING);
+    SetConfigFlags(FLAG_WINDOW_HIDDEN);
+    InitWindow(640, 360, "Shader Animation Benchmark");
+    if (!IsWindowReady()) {
+        fprintf(stderr, "ERROR: could not create an OpenGL context\n");
+        return 1;
+    }
+
+    double *samples = malloc(frames * sizeof(*samples));
+    assert(samples != NULL && "Buy MORE RAM lol!!");
+    Bench_Results results = {0};
+    for (size_t i = 0; i < plugs.count; ++i) {
+        if (!load_libplug(plugs.items[i])) {
+            fprintf(stderr, "ERROR: could not load %s, skipping it\n", plugs.items[i]);
+            continue;
+        }
+        plug_init();
+        for (size_t j = 0; j < sizes.count; ++j) {
+            Bench_Result result = bench_plug(plugs.items[i], sizes.items[j], frames, samples);
+            fprintf(stderr, "%s %zux%zu: median %.3fms, p99 %.3fms\n",
+                    result.plug, result.size.width, result.size.height, result.median, result.p99);
+            nob_da_append(&results, result);
+        }
+        unload_libplug();
+    }
+    free(samples);
+    if (libplug != NULL) dlclose(libplug);
+    CloseWindow();
+
+    FILE *f = stdout;
+    if (output_path != NULL) {
+        f = fopen(output_path, "w");
+        if (f == NULL) {
+            fprintf(stderr, "ERROR: could not create %s: %s\n", output_path, strerror(errno));
+            return 1;
+        }
+    }
+    if (json) {
+        report_json(f, results);
+    } else {
+        report_csv(f, results);
+    }
+    if (f != stdout) fclose(f);
+
+    return results.count == plugs.count * sizes.count ? 0 : 1;
+}
@@ -0,0 +1,282 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <raylib.h>
+#include "capture_pool.h"
+#include "png_stream.h"
+#include "trace.h"
+
+#define CAPTURE_POOL_MAX_WORKERS 16
+// Bands of rows a streamed capture buffers ahead of its encoder
+#define CAPTURE_STREAM_DEPTH 4
+
+typedef struct {
+    uint8_t *rows;
+    size_t count;
+} Capture_Band;
+
+struct Capture_Stream {
+    char *path;
+    size_t width;
+    size_t height;
+
+    Capture_Band bands[CAPTURE_STREAM_DEPTH];
+    size_t head;
+    size_t count;
+    // Set by capture_stream_end(), the worker frees the stream once it saw it
+    bool ended;
+    bool cancel;
+    // Set by the worker, the render thread stops sending rows
+    bool failed;
+    pthread_mutex_t mutex;
+    pthread_cond_t can_push;
+    pthread_cond_t can_pop;
+};
+
+typedef struct {
+    // Either a complete image in pixels or the rows of stream
+    uint8_t *pixels;
+    Capture_Stream *stream;
+    size_t width;
+    size_t height;
+    char *path;
+} Capture_Job;
+
+struct Capture_Pool {
+    pthread_t workers[CAPTURE_POOL_MAX_WORKERS];
+    size_t workers_count;
+    // Threads every worker deflates a single PNG with
+    size_t png_threads;
+
+    Capture_Job *jobs;
+    size_t depth;
+    size_t head;
+    size_t count;
+    bool stopping;
+    pthread_mutex_t mutex;
+    pthread_cond_t can_pop;
+};
+
+// Pops the bands of the stream into the PNG until the render thread ended it
+static bool capture_pool_encode_stream(Thread_Pool *png_pool, Capture_Stream *stream) {
+    Png_Stream *png = png_stream_start(stream->path, stream->width, stream->height, png_pool);
+    bool ok = png != NULL;
+
+    pthread_mutex_lock(&stream->mutex);
+    stream->failed = !ok;
+    for (;;) {
+        while (stream->count == 0 && !stream->ended) {
+            pthread_cond_wait(&stream->can_pop, &stream->mutex);
+        }
+        if (stream->count == 0) break;
+        Capture_Band band = stream->bands[stream->head];
+        stream->head = (stream->head + 1) % CAPTURE_STREAM_DEPTH;
+        stream->count -= 1;
+        pthread_cond_signal(&stream->can_push);
+        pthread_mutex_unlock(&stream->mutex);
+
+        if (ok) ok = png_stream_rows(png, band.rows, band.count);
+        free(band.rows);
+
+        pthread_mutex_lock(&stream->mutex);
+        if (!ok) stream->failed = true;
+    }
+    bool cancel = stream->cancel;
+    pthread_mutex_unlock(&stream->mutex);
+
+    if (png != NULL) ok = png_stream_end(png, cancel || !ok) && ok;
+    pthread_mutex_destroy(&stream->mutex);
+    pthread_cond_destroy(&stream->can_push);
+    pthread_cond_destroy(&stream->can_pop);
+    free(stream->path);
+    free(stream);
+    return ok && !cancel;
+}
+
+static void capture_pool_encode(Thread_Pool *png_pool, Capture_Job job) {
+    TRACE_SCOPE("encode capture");
+    bool ok = false;
+    Png_Stream *png = NULL;
+    if (job.stream != NULL) {
+        ok = capture_pool_encode_stream(png_pool, job.stream);
+    } else if ((png = png_stream_start(job.path, job.width, job.height, png_pool)) != NULL) {
+        ok = png_stream_rows(png, job.pixels, job.height);
+        ok = png_stream_end(png, !ok) && ok;
+    }
+    if (ok) {
+        TraceLog(LOG_INFO, "Capture saved as %s", job.path);
+    } else {
+        TraceLog(LOG_ERROR, "Could not save capture %s", job.path);
+    }
+    free(job.pixels);
+    free(job.path);
+}
+
+static void *capture_pool_worker(void *arg) {
+    Capture_Pool *pool = arg;
+    trace_thread_name("capture worker");
+    Thread_Pool *png_pool = thread_pool_start(pool->png_threads, "capture deflate");
+
+    pthread_mutex_lock(&pool->mutex);
+    for (;;) {
+        while (pool->count == 0 && !pool->stopping) {
+            pthread_cond_wait(&pool->can_pop, &pool->mutex);
+        }
+        // Queued captures are still written when stopping
+        if (pool->count == 0) break;
+
+        Capture_Job job = pool->jobs[pool->head];
+        pool->head = (pool->head + 1) % pool->depth;
+        pool->count -= 1;
+        pthread_mutex_unlock(&pool->mutex);
+
+        capture_pool_encode(png_pool, job);
+
+        pthread_mutex_lock(&pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    thread_pool_end(png_pool);
+    return NULL;
+}
+
+Capture_Pool *capture_pool_start(size_t workers, size_t depth) {
+    Capture_Pool *pool = calloc(1, sizeof(Capture_Pool));
+    assert(pool != NULL && "Buy MORE RAM lol!!");
+    if (depth < 1) depth = 1;
+    pool->jobs = calloc(depth, sizeof(*pool->jobs));
+    assert(pool->jobs != NULL && "Buy MORE RAM lol!!");
+    pool->depth = depth;
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (workers < 1) workers = 1;
+    if (workers > CAPTURE_POOL_MAX_WORKERS) workers = CAPTURE_POOL_MAX_WORKERS;
+    pool->png_threads = cpus > (long)workers ? cpus / workers : 1;
+
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->can_pop, NULL);
+    for (size_t i = 0; i < workers; ++i) {
+        if (pthread_create(&pool->workers[pool->workers_count], NULL, capture_pool_worker, pool) != 0) {
+            TraceLog(LOG_WARNING, "CAPTURE: could only start %zu of %zu workers", pool->workers_count, workers);
+            break;
+        }
+        pool->workers_count += 1;
+    }
+    return pool;
+}
+
+// Never blocks, false if the queue is full
+static bool capture_pool_push(Capture_Pool *pool, Capture_Job job) {
+    pthread_mutex_lock(&pool->mutex);
+    bool queued = pool->count < pool->depth;
+    if (queued) {
+        pool->jobs[(pool->head + pool->count) % pool->depth] = job;
+        pool->count += 1;
+        pthread_cond_signal(&pool->can_pop);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    if (!queued) {
+        TraceLog(LOG_WARNING, "CAPTURE: %zu captures are still being written, dropping %s", pool->depth, job.path);
+    }
+    return queued;
+}
+
+bool capture_pool_submit(Capture_Pool *pool, uint8_t *pixels, size_t width, size_t height, const char *path) {
+    Capture_Job job = { .pixels = pixels, .width = width, .height = height, .path = strdup(path) };
+    assert(job.path != NULL && "Buy MORE RAM lol!!");
+
+    // Without any worker the capture is encoded right here
+    if (pool->workers_count == 0) {
+        capture_pool_encode(NULL, job);
+        return true;
+    }
+
+    if (capture_pool_push(pool, job)) return true;
+    free(job.pixels);
+    free(job.path);
+    return false;
+}
+
+Capture_Stream *capture_pool_stream(Capture_Pool *pool, const char *path, size_t width, size_t height) {
+    // The rows could only be encoded right here, which is what streaming avoids
+    if (pool->workers_count == 0) return NULL;
+
+    Capture_Stream *stream = calloc(1, sizeof(Capture_Stream));
+    assert(stream != NULL && "Buy MORE RAM lol!!");
+    stream->path = strdup(path);
+    assert(stream->path != NULL && "Buy MORE RAM lol!!");
+    stream->width = width;
+    stream->height = height;
+    pthread_mutex_init(&stream->mutex, NULL);
+    pthread_cond_init(&stream->can_push, NULL);
+    pthread_cond_init(&stream->can_pop, NULL);
+
+    Capture_Job job = { .stream = stream, .width = width, .height = height, .path = strdup(path) };
+    assert(job.path != NULL && "Buy MORE RAM lol!!");
+    if (capture_pool_push(pool, job)) return stream;
+    free(job.path);
+    pthread_mutex_destroy(&stream->mutex);
+    pthread_cond_destroy(&stream->can_push);
+    pthread_cond_destroy(&stream->can_pop);
+    free(stream->path);
+    free(stream);
+    return NULL;
+}
+
+bool capture_stream_rows(Capture_Stream *stream, const uint8_t *rows, size_t count) {
+    size_t size = 4 * stream->width * count;
+    Capture_Band band = { .rows = malloc(size), .count = count };
+    assert(band.rows != NULL && "Buy MORE RAM lol!!");
+    memcpy(band.rows, rows, size);
+
+    pthread_mutex_lock(&stream->mutex);
+    while (stream->count == CAPTURE_STREAM_DEPTH && !stream->failed) {
+        pthread_cond_wait(&stream->can_push, &stream->mutex);
+    }
+    bool ok = !stream->failed;
+    if (ok) {
+        stream->bands[(stream->head + stream->count) % CAPTURE_STREAM_DEPTH] = band;
+        stream->count += 1;
+        pthread_cond_signal(&stream->can_pop);
+    }
+    pthread_mutex_unlock(&stream->mutex);
+    if (!ok) free(band.rows);
+    return ok;
+}
+
+void capture_stream_end(Capture_Stream *stream, bool cancel) {
+    pthread_mutex_lock(&stream->mutex);
+    stream->ended = true;
+    stream->cancel = cancel;
+    pthread_cond_signal(&stream->can_pop);
+    pthread_mutex_unlock(&stream->mutex);
+}
+
+void capture_pool_end(Capture_Pool *pool) {
+    pthread_mutex_lock(&pool->mutex);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->can_pop);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (size_t i = 0; i < pool->workers_count; ++i) {
+        pthread_join(pool->workers[i], NULL);
+    }
+    pthread_mutex_destroy(&pool->mutex);
+    pthread_cond_destroy(&pool->can_pop);
+    free(pool->jobs);
+    free(pool);
+}
+
+void capture_timestamped_path(const char *prefix, char *path, size_t path_size) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    struct tm tm;
+    localtime_r(&ts.tv_sec, &tm);
+    char stamp[32];
+    strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &tm);
+    snprintf(path, path_size, "%s_%s-%03ld.png", prefix, stamp, ts.tv_nsec / 1000000);
+}
@@ -0,0 +1,41 @@
+#ifndef CAPTURE_POOL_H_
+#define CAPTURE_POOL_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Background workers that encode captured frames into PNG files, so taking
+// a screenshot never stalls the render loop on compression and disk I/O.
+typedef struct Capture_Pool Capture_Pool;
+
+// depth is the amount of captures waiting for a worker at most
+Capture_Pool *capture_pool_start(size_t workers, size_t depth);
+// Queues top-down RGBA8 pixels for encoding into path. The pool takes
+// ownership of pixels (malloc()ed) in any case. Never blocks: if the queue is
+// full the capture is dropped and false is returned.
+bool capture_pool_submit(Capture_Pool *pool, uint8_t *pixels, size_t width, size_t height, const char *path);
+
+// A capture handed over in bands of rows while it is rendered, so neither the
+// full image nor its compression ever sits on the render thread
+typedef struct Capture_Stream Capture_Stream;
+
+// Queues a PNG of width x height into path whose rows follow with
+// capture_stream_rows(). Returns NULL if the queue is full (the capture is
+// dropped) or the pool has no worker.
+Capture_Stream *capture_pool_stream(Capture_Pool *pool, const char *path, size_t width, size_t height);
+// Copies `count` top-down RGBA8 rows. Only waits while CAPTURE_STREAM_DEPTH
+// bands are still queued, which bounds the memory of huge captures. Returns
+// false once the encoding failed.
+bool capture_stream_rows(Capture_Stream *stream, const uint8_t *rows, size_t count);
+// Hands the stream over for good, cancel removes the file. Does not wait for
+// the encoding, the pool frees the stream.
+void capture_stream_end(Capture_Stream *stream, bool cancel);
+
+// Waits for the queued captures to be written
+void capture_pool_end(Capture_Pool *pool);
+
+// Fills path with prefix_YYYYMMDD-HHMMSS-mmm.png in local time
+void capture_timestamped_path(const char *prefix, char *path, size_t path_size);
+
+#endif // CAPTURE_POOL_H_
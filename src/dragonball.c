@@ -15,6 +15,7 @@ typedef struct {
     int timeLoc;
     int resolutionLoc;
     int originLoc;
+    int tileOffsetLoc;
 
     const char *text;
     size_t fontSize;
@@ -27,6 +28,7 @@ typedef struct {
     int timeLoc;
     int resolutionLoc;
     int textureLoc;
+    int tileOffsetLoc;
     Texture2D envTexture;
 } DragonBall;
 
@@ -40,6 +42,7 @@ typedef struct {
 } Plug;
 
 static Plug *p = NULL;
+static Vector2 tile_offset = {0};
 
 static void load_resources(void) {
     p->font = LoadFontEx("./assets/fonts/iosevka-regular.ttf", FONT_SIZE, NULL, 0);
@@ -47,6 +50,7 @@ static void load_resources(void) {
     p->db.timeLoc = GetShaderLocation(p->db.shader, "time");
     p->db.resolutionLoc = GetShaderLocation(p->db.shader, "resolution");
     p->db.textureLoc = GetShaderLocation(p->db.shader, "texture1");
+    p->db.tileOffsetLoc = GetShaderLocation(p->db.shader, "tileOffset");
 
     // Load environment
     p->db.envTexture = LoadTexture("./assets/textures/environment.png");
@@ -55,6 +59,7 @@ static void load_resources(void) {
     p->info.timeLoc = GetShaderLocation(p->info.shader, "u_time");
     p->info.resolutionLoc = GetShaderLocation(p->info.shader, "u_resolution");
     p->info.originLoc = GetShaderLocation(p->info.shader, "u_origin");
+    p->info.tileOffsetLoc = GetShaderLocation(p->info.shader, "u_tile_offset");
     p->info.text = "Made by realsanjeev";
 
     if (p->info.originLoc == -1) {
@@ -73,6 +78,11 @@ void plug_reset(void) {
     p->time = 0.0f;
 }
 
+// Offset of gl_FragCoord when main renders the frame in tiles, see tiled.h
+void plug_set_tile(float x, float y) {
+    tile_offset = (Vector2){x, y};
+}
+
 void plug_init(void) {
     if (!p) {
         p = calloc(1, sizeof(Plug));
@@ -149,6 +159,7 @@ void plug_update(float dt, float w, float h, bool  render) {
     BeginShaderMode(p->db.shader);
         SetShaderValue(p->db.shader, p->db.timeLoc, &p->time, SHADER_UNIFORM_FLOAT);
         SetShaderValue(p->db.shader, p->db.resolutionLoc, resolution, SHADER_UNIFORM_VEC2);
+        SetShaderValue(p->db.shader, p->db.tileOffsetLoc, &tile_offset, SHADER_UNIFORM_VEC2);
         SetShaderValueTexture(p->db.shader, p->db.textureLoc, p->db.envTexture);
 
         // Scale environment.png to screen dimensions
@@ -197,6 +208,7 @@ void plug_update(float dt, float w, float h, bool  render) {
         SetShaderValue(p->info.shader, p->info.timeLoc, &p->time, SHADER_UNIFORM_FLOAT);
         SetShaderValue(p->info.shader, p->info.resolutionLoc, infoResolution, SHADER_UNIFORM_VEC2);
         SetShaderValue(p->info.shader, p->info.originLoc, origin, SHADER_UNIFORM_VEC2);
+        SetShaderValue(p->info.shader, p->info.tileOffsetLoc, &tile_offset, SHADER_UNIFORM_VEC2);
         DrawRectangleRec(p->info.textBounds, BLANK);
     EndShaderMode();
 
@@ -39,6 +39,12 @@ void plug_reset(void)
     p->time = 0.0f;
 }
 
+// example.fs does not depend on gl_FragCoord, nothing to offset
+void plug_set_tile(float x, float y) {
+    (void)x;
+    (void)y;
+}
+
 void plug_init(void) {
     if (!p) {
         p = calloc(1, sizeof(Plug));
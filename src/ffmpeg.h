@@ -4,10 +4,77 @@
 #include <stddef.h>  // Include stddef.h for size_t
 #include <stdbool.h>
 
+#include "thread_pool.h"
+
 typedef struct FFMPEG FFMPEG;
 
-FFMPEG *ffmpeg_start_rendering(size_t width, size_t height, size_t fps);
+typedef enum {
+    FFMPEG_SINK_PIPE,  // Pipe raw frames into an ffmpeg child process
+    FFMPEG_SINK_Y4M,   // Write a YUV4MPEG2 file natively, always yuv420p
+    FFMPEG_SINK_RAW,   // Write headerless rgba/yuv420p frames through a memory-mapped file
+} FFMPEG_Sink;
+
+typedef struct {
+    size_t width;
+    size_t height;
+    size_t fps;
+    FFMPEG_Sink sink;
+    const char *output_path;
+    // Number of pre-allocated frame slots drained by a background writer
+    // thread. 0 writes every frame synchronously.
+    size_t queue_depth;
+    // Convert frames to I420 in-process (see yuv.h), so the output carries
+    // 12 instead of 32 bits per pixel and ffmpeg skips its own conversion.
+    bool yuv420p;
+    // Converts those frames, owned by the caller and shared by every segment
+    // of the rendering, so parallel encoders do not each start one thread per
+    // CPU. NULL converts on the sending thread alone.
+    Thread_Pool *yuv_pool;
+    // Hand queued frames to the ffmpeg pipe with vmsplice() instead of
+    // copying them. Needs a queue_depth of at least 2 and falls back to
+    // plain writes when the kernel refuses.
+    bool zero_copy;
+    // Split a FFMPEG_SINK_PIPE rendering into parts of segment_frames frames,
+    // each encoded by its own ffmpeg process, and concatenate them without
+    // re-encoding at the end. Up to segment_parallel encoders run at once,
+    // each keeping queue_depth frames buffered. 0 encodes a single stream.
+    size_t segment_frames;
+    size_t segment_parallel;
+
+    // Encoder of FFMPEG_SINK_PIPE, NULL/0 keeps ffmpeg_linux.c's defaults
+    // (libx264, veryfast, crf 18, yuv420p). The default preset and crf are
+    // only passed along with the default codec.
+    const char *codec;     // -c:v
+    const char *preset;    // -preset
+    const char *crf;       // -crf, ignored when bitrate is set
+    const char *bitrate;   // -b:v, e.g. "8M"
+    const char *pix_fmt;   // -pix_fmt of the encoded video
+    size_t threads;        // -threads, 0 lets ffmpeg decide
+    // Passed verbatim right before the output path
+    const char **extra_args;
+    size_t extra_args_count;
+} FFMPEG_Settings;
+
+// Cumulative counters of a rendering, segmented renderings sum up all of their parts
+typedef struct {
+    size_t frames_sent;     // Accepted by ffmpeg_send_frame*()
+    size_t frames_written;  // Handed to the pipe or output file
+    size_t queued;          // Frames waiting in the queue right now
+    double convert_time;    // Seconds spent copying/converting frames into the queue
+    double wait_time;       // Seconds the sender blocked on a full queue
+    double write_time;      // Seconds spent writing frames out, usually on the writer thread
+} FFMPEG_Stats;
+
+// Whether an ffmpeg executable can be found in PATH for FFMPEG_SINK_PIPE
+bool ffmpeg_is_available(void);
+
+FFMPEG *ffmpeg_start_rendering(const FFMPEG_Settings *settings);
+// Sends an RGBA8 frame whose rows start at the top of the image
+bool ffmpeg_send_frame(FFMPEG *ffmpeg, void *data, size_t width, size_t height);
+// Sends an RGBA8 frame stored bottom row first, as read back from OpenGL
 bool ffmpeg_send_frame_flipped(FFMPEG *ffmpeg, void *data, size_t width, size_t height);
 bool ffmpeg_end_rendering(FFMPEG *ffmpeg, bool cancel);
+// Snapshot of the counters, safe to call while the writer thread is running
+void ffmpeg_get_stats(FFMPEG *ffmpeg, FFMPEG_Stats *stats);
 
 #endif // FFMPEG_H_
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE // vmsplice() and F_SETPIPE_SZ
 #include <assert.h>
 #include <stdio.h>
 #include <stdint.h>
@@ -6,34 +7,397 @@
 #include <string.h> // Include for strerror
 
 #include <signal.h>
+#include <fcntl.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <limits.h>
+#include <time.h>
 #include <unistd.h>
+#include <pthread.h>
 
 #include <raylib.h>
 #include "ffmpeg.h"
+#include "yuv.h"
+#include "trace.h"
 
 #define READ_END 0
 #define WRITE_END 1
 
+#ifdef IOV_MAX
+#define FFMPEG_IOV_BATCH IOV_MAX
+#else
+#define FFMPEG_IOV_BATCH 1024
+#endif
+
+#define FFMPEG_DEFAULT_PIPE_MAX_SIZE (1024*1024)
+// Encoder defaults when FFMPEG_Settings leaves them unset
+#define FFMPEG_DEFAULT_CODEC "libx264"
+#define FFMPEG_DEFAULT_PRESET "veryfast"
+#define FFMPEG_DEFAULT_CRF "18"
+#define FFMPEG_DEFAULT_PIX_FMT "yuv420p"
+// Upper bound of the generated ffmpeg command line without extra_args
+#define FFMPEG_MAX_BASE_ARGS 40
+
+// The raw sink grows its file by this many frames at a time
+#define FFMPEG_RAW_GROW_FRAMES 64
+
+typedef struct {
+    pthread_t thread;
+    FFMPEG *ffmpeg;
+    bool ok;
+} FFMPEG_Finisher;
+
+typedef struct {
+    void *data;
+    size_t size;
+    bool flipped;
+    // Total amount of bytes pushed into the pipe once this slot was spliced
+    size_t spliced_end;
+} FFMPEG_Slot;
+
 struct FFMPEG {
-    int pipe;
+    // Segmented encoding: this handle only dispatches frames to a chain of
+    // child renderings, each encoding segment_frames frames into its own
+    // part file. Finished segments drain in the background while the next
+    // one already receives frames.
+    FFMPEG_Settings settings;
+    char *output_path;
+    FFMPEG *segment;
+    size_t segment_index;
+    size_t segment_sent;
+    // Each finisher is allocated on its own so its thread keeps a stable
+    // address while the array of pointers grows
+    FFMPEG_Finisher **finishers;
+    size_t finishers_count;
+    size_t finishers_joined;
+    bool segments_failed;
+
+    // Counters are always accumulated into stats_owner, which is the
+    // segment dispatcher for segments and the handle itself otherwise
+    FFMPEG *stats_owner;
+    FFMPEG_Stats stats;
+    pthread_mutex_t stats_mutex;
+
+    FFMPEG_Sink sink;
+    // Pipe into the ffmpeg child, or the output file of the native sinks
+    int fd;
     pid_t pid;
+
+    // Raw sink: frames are copied into a window of the file mapped at offset
+    size_t raw_offset;
+    size_t raw_capacity;
+    uint8_t *raw_map;
+    size_t raw_map_size;
+    uint8_t *raw_cursor;
+
+    // Frame queue drained by the writer thread. Slots are allocated once
+    // up front, the render loop only copies into a free one.
+    size_t width;
+    size_t height;
+    size_t fps;
+
+    // Frames are converted to I420 in-process and piped as yuv420p
+    bool yuv420p;
+    // Borrowed from FFMPEG_Settings
+    Thread_Pool *yuv_pool;
+    uint8_t *yuv_scratch;
+
+    // Zero-copy transport: slots are page-aligned and vmsplice()d into the
+    // pipe, so the pipe references their pages instead of copying them. A
+    // slot can only be refilled once ffmpeg must have read all of it, which
+    // is after at least pipe_size more bytes got queued behind it.
+    bool zero_copy;
+    size_t pipe_size;
+    size_t spliced;
+    size_t spliced_total;
+
+    FFMPEG_Slot *slots;
+    size_t depth;
+    size_t head;
+    size_t count;
+    bool stopping;
+    bool discard;
+    bool failed;
+    bool has_writer;
+    pthread_t writer;
+    pthread_mutex_t mutex;
+    pthread_cond_t can_push;
+    pthread_cond_t can_pop;
 };
 
+static bool ffmpeg_write(FFMPEG *ffmpeg, void *data, size_t width, size_t height, bool flipped, bool owned);
+static bool ffmpeg_write_all(FFMPEG *ffmpeg, struct iovec *iov, size_t count, bool owned);
+
+static double ffmpeg_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+static void ffmpeg_stats_add(FFMPEG *ffmpeg, size_t sent, size_t written, double convert_time, double wait_time, double write_time) {
+    FFMPEG *owner = ffmpeg->stats_owner;
+    pthread_mutex_lock(&owner->stats_mutex);
+    owner->stats.frames_sent += sent;
+    owner->stats.frames_written += written;
+    owner->stats.convert_time += convert_time;
+    owner->stats.wait_time += wait_time;
+    owner->stats.write_time += write_time;
+    pthread_mutex_unlock(&owner->stats_mutex);
+}
+
+static size_t ffmpeg_frame_size(FFMPEG *ffmpeg) {
+    if (ffmpeg->yuv420p) return yuv420p_size(ffmpeg->width, ffmpeg->height);
+    return sizeof(uint32_t) * ffmpeg->width * ffmpeg->height;
+}
+
+static bool ffmpeg_raw_map_frame(FFMPEG *ffmpeg, size_t size) {
+    if (ffmpeg->raw_offset + size > ffmpeg->raw_capacity) {
+        // Reserve the blocks up front, writing through a mapping into a hole of a full disk is a SIGBUS
+        size_t capacity = ffmpeg->raw_offset + size * FFMPEG_RAW_GROW_FRAMES;
+        int err = posix_fallocate(ffmpeg->fd, ffmpeg->raw_capacity, capacity - ffmpeg->raw_capacity);
+        if (err != 0) {
+            TraceLog(LOG_ERROR, "FFMPEG: could not grow the raw output file to %zu bytes: %s", capacity, strerror(err));
+            return false;
+        }
+        ffmpeg->raw_capacity = capacity;
+    }
+
+    // mmap() offsets have to be page-aligned, frames generally are not
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    size_t map_offset = ffmpeg->raw_offset / page_size * page_size;
+    ffmpeg->raw_map_size = ffmpeg->raw_offset - map_offset + size;
+    ffmpeg->raw_map = mmap(NULL, ffmpeg->raw_map_size, PROT_WRITE, MAP_SHARED, ffmpeg->fd, map_offset);
+    if (ffmpeg->raw_map == MAP_FAILED) {
+        TraceLog(LOG_ERROR, "FFMPEG: could not map the raw output file: %s", strerror(errno));
+        ffmpeg->raw_map = NULL;
+        return false;
+    }
+    ffmpeg->raw_cursor = ffmpeg->raw_map + (ffmpeg->raw_offset - map_offset);
+    return true;
+}
+
+// owned means the slot memory stays untouched until the pipe is done with it
+static bool ffmpeg_write_slot(FFMPEG *ffmpeg, FFMPEG_Slot slot, bool owned) {
+    switch (ffmpeg->sink) {
+    case FFMPEG_SINK_Y4M: {
+        char frame_header[] = "FRAME\n";
+        struct iovec iov = { .iov_base = frame_header, .iov_len = sizeof(frame_header) - 1 };
+        if (!ffmpeg_write_all(ffmpeg, &iov, 1, false)) return false;
+    } break;
+    case FFMPEG_SINK_RAW:
+        if (!ffmpeg_raw_map_frame(ffmpeg, slot.size)) return false;
+        break;
+    case FFMPEG_SINK_PIPE:
+        break;
+    }
+
+    bool ok = false;
+    if (slot.flipped) {
+        ok = ffmpeg_write(ffmpeg, slot.data, ffmpeg->width, ffmpeg->height, true, owned);
+    } else {
+        struct iovec iov = { .iov_base = slot.data, .iov_len = slot.size };
+        ok = ffmpeg_write_all(ffmpeg, &iov, 1, owned);
+    }
+
+    if (ffmpeg->raw_map != NULL) {
+        munmap(ffmpeg->raw_map, ffmpeg->raw_map_size);
+        ffmpeg->raw_map = NULL;
+        ffmpeg->raw_offset += slot.size;
+    }
+    return ok;
+}
+
+static bool ffmpeg_slot_consumed(FFMPEG *ffmpeg, FFMPEG_Slot *slot) {
+    if (!ffmpeg->zero_copy) return true;
+    return ffmpeg->spliced_total - slot->spliced_end >= ffmpeg->pipe_size;
+}
+
+static void *ffmpeg_writer_thread(void *arg) {
+    FFMPEG *ffmpeg = arg;
+    trace_thread_name("ffmpeg writer");
+
+    pthread_mutex_lock(&ffmpeg->mutex);
+    for (;;) {
+        // Slots [head, head + spliced) are in the pipe, [head + spliced, head + count) are waiting
+        while (ffmpeg->count == ffmpeg->spliced && !ffmpeg->stopping) {
+            pthread_cond_wait(&ffmpeg->can_pop, &ffmpeg->mutex);
+        }
+        if (ffmpeg->discard || ffmpeg->count == ffmpeg->spliced) break;
+
+        size_t index = (ffmpeg->head + ffmpeg->spliced) % ffmpeg->depth;
+        FFMPEG_Slot slot = ffmpeg->slots[index];
+        pthread_mutex_unlock(&ffmpeg->mutex);
+
+        double start = ffmpeg_now();
+        trace_begin("ffmpeg_write_slot");
+        bool ok = ffmpeg_write_slot(ffmpeg, slot, true);
+        trace_end();
+        if (ok) ffmpeg_stats_add(ffmpeg, 0, 1, 0, 0, ffmpeg_now() - start);
+
+        pthread_mutex_lock(&ffmpeg->mutex);
+        if (!ok) {
+            ffmpeg->failed = true;
+            pthread_cond_broadcast(&ffmpeg->can_push);
+            break;
+        }
+        ffmpeg->spliced_total += slot.size;
+        ffmpeg->slots[index].spliced_end = ffmpeg->spliced_total;
+        ffmpeg->spliced += 1;
+
+        while (ffmpeg->spliced > 0 && ffmpeg_slot_consumed(ffmpeg, &ffmpeg->slots[ffmpeg->head])) {
+            ffmpeg->head = (ffmpeg->head + 1) % ffmpeg->depth;
+            ffmpeg->count -= 1;
+            ffmpeg->spliced -= 1;
+            pthread_cond_signal(&ffmpeg->can_push);
+        }
+    }
+    pthread_mutex_unlock(&ffmpeg->mutex);
+
+    return NULL;
+}
+
+static bool ffmpeg_start_writer(FFMPEG *ffmpeg, size_t depth) {
+    size_t frame_size = ffmpeg_frame_size(ffmpeg);
+
+    // Every slot that is still referenced by the pipe is unavailable to the
+    // render loop, at least one slot has to stay free to avoid a deadlock
+    if (ffmpeg->zero_copy && (depth < 2 || ffmpeg->pipe_size > (depth - 1) * frame_size)) {
+        TraceLog(LOG_WARNING, "FFMPEG: queue of %zu frames is too short for zero-copy with a %zu bytes pipe, using plain writes", depth, ffmpeg->pipe_size);
+        ffmpeg->zero_copy = false;
+    }
+
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    size_t slot_size = (frame_size + page_size - 1) / page_size * page_size;
+
+    ffmpeg->slots = calloc(depth, sizeof(*ffmpeg->slots));
+    assert(ffmpeg->slots != NULL && "Buy MORE RAM lol!!");
+    for (size_t i = 0; i < depth; ++i) {
+        ffmpeg->slots[i].data = aligned_alloc(page_size, slot_size);
+        assert(ffmpeg->slots[i].data != NULL && "Buy MORE RAM lol!!");
+    }
+    ffmpeg->depth = depth;
+
+    pthread_mutex_init(&ffmpeg->mutex, NULL);
+    pthread_cond_init(&ffmpeg->can_push, NULL);
+    pthread_cond_init(&ffmpeg->can_pop, NULL);
+
+    int err = pthread_create(&ffmpeg->writer, NULL, ffmpeg_writer_thread, ffmpeg);
+    if (err != 0) {
+        TraceLog(LOG_WARNING, "FFMPEG: could not start writer thread, falling back to synchronous writes: %s", strerror(err));
+        return false;
+    }
+    ffmpeg->has_writer = true;
+    return true;
+}
+
+static void ffmpeg_stop_writer(FFMPEG *ffmpeg, bool cancel) {
+    if (ffmpeg->has_writer) {
+        pthread_mutex_lock(&ffmpeg->mutex);
+        ffmpeg->stopping = true;
+        ffmpeg->discard = cancel;
+        pthread_cond_broadcast(&ffmpeg->can_pop);
+        pthread_mutex_unlock(&ffmpeg->mutex);
+
+        pthread_join(ffmpeg->writer, NULL);
+        ffmpeg->has_writer = false;
+    }
+}
+
+// Spliced slots may still be referenced by the pipe, only call this once ffmpeg is gone
+static void ffmpeg_free_slots(FFMPEG *ffmpeg) {
+    if (ffmpeg->slots != NULL) {
+        pthread_mutex_destroy(&ffmpeg->mutex);
+        pthread_cond_destroy(&ffmpeg->can_push);
+        pthread_cond_destroy(&ffmpeg->can_pop);
+        for (size_t i = 0; i < ffmpeg->depth; ++i) free(ffmpeg->slots[i].data);
+        free(ffmpeg->slots);
+        ffmpeg->slots = NULL;
+    }
+}
+
+
+// Enlarges the pipe up to one frame, which also lets plain writes move more per syscall
+static size_t ffmpeg_grow_pipe(int pipe, size_t frame_size) {
+    size_t max_size = FFMPEG_DEFAULT_PIPE_MAX_SIZE;
+    FILE *f = fopen("/proc/sys/fs/pipe-max-size", "r");
+    if (f != NULL) {
+        if (fscanf(f, "%zu", &max_size) != 1) max_size = FFMPEG_DEFAULT_PIPE_MAX_SIZE;
+        fclose(f);
+    }
+
+    size_t wanted = frame_size < max_size ? frame_size : max_size;
+    if (fcntl(pipe, F_SETPIPE_SZ, (int)wanted) < 0) {
+        TraceLog(LOG_WARNING, "FFMPEG: could not resize the pipe to %zu bytes: %s", wanted, strerror(errno));
+    }
 
-FFMPEG *ffmpeg_start_rendering(size_t width, size_t height, size_t fps) {
+    int size = fcntl(pipe, F_GETPIPE_SZ);
+    return size > 0 ? (size_t)size : 0;
+}
+
+static bool ffmpeg_spawn(const FFMPEG_Settings *settings, bool yuv420p, int *fd, pid_t *pid) {
     int pipefd[2];
 
-    if (pipe(pipefd) < 0) {
+    // The command line is assembled before fork(), other threads may hold
+    // locks the child would deadlock on
+    char resolution[64];
+    snprintf(resolution, sizeof(resolution), "%zux%zu", settings->width, settings->height);
+    char framerate[64];
+    snprintf(framerate, sizeof(framerate), "%zu", settings->fps);
+    char threads[64];
+    snprintf(threads, sizeof(threads), "%zu", settings->threads);
+
+    const char *args[FFMPEG_MAX_BASE_ARGS + settings->extra_args_count];
+    size_t args_count = 0;
+    #define ARG(arg) args[args_count++] = (arg)
+    ARG("ffmpeg");
+    ARG("-loglevel"); ARG("verbose");
+    ARG("-y");
+
+    ARG("-f"); ARG("rawvideo");
+    ARG("-pix_fmt"); ARG(yuv420p ? "yuv420p" : "rgba");
+    ARG("-s"); ARG(resolution);
+    ARG("-r"); ARG(framerate);
+    ARG("-i"); ARG("-");
+
+    ARG("-r"); ARG(framerate);
+    ARG("-c:v"); ARG(settings->codec ? settings->codec : FFMPEG_DEFAULT_CODEC);
+    ARG("-pix_fmt"); ARG(settings->pix_fmt ? settings->pix_fmt : FFMPEG_DEFAULT_PIX_FMT);
+    // The default preset and crf are libx264 specific, other codecs only get what was asked for
+    if (settings->preset || !settings->codec) {
+        ARG("-preset"); ARG(settings->preset ? settings->preset : FFMPEG_DEFAULT_PRESET);
+    }
+    // A target bitrate replaces constant quality rate control
+    if (settings->bitrate) {
+        ARG("-b:v"); ARG(settings->bitrate);
+    } else if (settings->crf || !settings->codec) {
+        ARG("-crf"); ARG(settings->crf ? settings->crf : FFMPEG_DEFAULT_CRF);
+    }
+    if (settings->threads > 0) {
+        ARG("-threads"); ARG(threads);
+    }
+    for (size_t i = 0; i < settings->extra_args_count; ++i) {
+        ARG(settings->extra_args[i]);
+    }
+    ARG(settings->output_path);
+    ARG(NULL);
+    #undef ARG
+    assert(args_count <= sizeof(args)/sizeof(args[0]));
+
+    // Close-on-exec, so ffmpeg children of other segments don't keep this pipe open
+    if (pipe2(pipefd, O_CLOEXEC) < 0) {
         TraceLog(LOG_ERROR, "FFMPEG: Could not create a pipe: %s", strerror(errno));
-        return NULL;
+        return false;
     }
 
     pid_t child = fork();
     if (child < 0) {
         TraceLog(LOG_ERROR, "FFMPEG: Could not fork a child: %s", strerror(errno));
-        return NULL;
+        close(pipefd[READ_END]);
+        close(pipefd[WRITE_END]);
+        return false;
     }
 
     if (child == 0) {
@@ -43,32 +407,7 @@ FFMPEG *ffmpeg_start_rendering(size_t width, size_t height, size_t fps) {
         }
         close(pipefd[WRITE_END]); // Close the write end in the child process
 
-        char resolution[64];
-        snprintf(resolution, sizeof(resolution), "%zux%zu", width, height);
-        char framerate[64];
-        snprintf(framerate, sizeof(framerate), "%zu", fps);
-
-        int ret = execlp("ffmpeg",
-            "ffmpeg",
-            "-loglevel", "verbose",
-            "-y",
-
-            "-f", "rawvideo",
-            "-pix_fmt", "rgba",
-            "-s", resolution,
-            "-r", framerate,
-            "-i", "-",
-            "-r", framerate,
-            "-c:v", "libx264",
-            "-vb", "2500k",
-            "-c:a", "aac",
-            "-ab", "200k",
-            "-pix_fmt", "yuv420p",
-            "-crf", "18", "-preset", "veryfast",
-            "output.mp4",
-
-            NULL
-        );
+        int ret = execvp("ffmpeg", (char * const *)args);
         if (ret < 0) {
             TraceLog(LOG_ERROR, "FFMPEG CHILD: Could not run ffmpeg as a child process: %s", strerror(errno));
             exit(1);
@@ -80,26 +419,249 @@ FFMPEG *ffmpeg_start_rendering(size_t width, size_t height, size_t fps) {
         TraceLog(LOG_WARNING, "FFMPEG: could not close read end of the pipe on the parent's end: %s", strerror(errno));
     }
 
-    FFMPEG *ffmpeg = malloc(sizeof(FFMPEG));
-    assert(ffmpeg != NULL && "Buy MORE RAM lol!!");
-    ffmpeg->pid = child;
-    ffmpeg->pipe = pipefd[WRITE_END];
 
-    return ffmpeg;
+    *fd = pipefd[WRITE_END];
+    *pid = child;
+    return true;
 }
 
-bool ffmpeg_end_rendering(FFMPEG *ffmpeg, bool cancel) {
-    int pipe = ffmpeg->pipe;
-    pid_t pid = ffmpeg->pid;
+static bool ffmpeg_open_file(FFMPEG *ffmpeg, const char *path) {
+    int flags = O_CREAT | O_TRUNC | O_CLOEXEC | (ffmpeg->sink == FFMPEG_SINK_RAW ? O_RDWR : O_WRONLY);
+    ffmpeg->fd = open(path, flags, 0644);
+    if (ffmpeg->fd < 0) {
+        TraceLog(LOG_ERROR, "FFMPEG: could not open %s: %s", path, strerror(errno));
+        return false;
+    }
+
+    if (ffmpeg->sink == FFMPEG_SINK_Y4M) {
+        // yuv420p in BT.601 limited range, see yuv.h
+        char header[256];
+        int n = snprintf(header, sizeof(header), "YUV4MPEG2 W%zu H%zu F%zu:1 Ip A1:1 C420jpeg XCOLORRANGE=LIMITED\n",
+                         ffmpeg->width, ffmpeg->height, ffmpeg->fps);
+        struct iovec iov = { .iov_base = header, .iov_len = n };
+        if (!ffmpeg_write_all(ffmpeg, &iov, 1, false)) {
+            close(ffmpeg->fd);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ffmpeg_is_available(void) {
+    const char *path = getenv("PATH");
+    if (path == NULL) return false;
+
+    while (*path != '\0') {
+        size_t len = strcspn(path, ":");
+        char candidate[PATH_MAX];
+        snprintf(candidate, sizeof(candidate), "%.*s/ffmpeg", (int)len, path);
+        if (access(candidate, X_OK) == 0) return true;
+        path += len;
+        if (*path == ':') path += 1;
+    }
+    return false;
+}
+
+static bool ffmpeg_wait(pid_t pid);
+
+// output.mp4 -> output.part0003.mp4
+static void ffmpeg_segment_path(const char *output_path, size_t index, char *path, size_t path_size) {
+    const char *slash = strrchr(output_path, '/');
+    const char *dot = strrchr(output_path, '.');
+    if (dot == NULL || (slash != NULL && dot < slash)) dot = output_path + strlen(output_path);
+    snprintf(path, path_size, "%.*s.part%04zu%s", (int)(dot - output_path), output_path, index, dot);
+}
+
+static void *ffmpeg_finisher_thread(void *arg) {
+    FFMPEG_Finisher *finisher = arg;
+    finisher->ok = ffmpeg_end_rendering(finisher->ffmpeg, false);
+    return NULL;
+}
+
+static void ffmpeg_join_finisher(FFMPEG *ffmpeg) {
+    FFMPEG_Finisher *finisher = ffmpeg->finishers[ffmpeg->finishers_joined++];
+    pthread_join(finisher->thread, NULL);
+    if (!finisher->ok) ffmpeg->segments_failed = true;
+    free(finisher);
+}
+
+static bool ffmpeg_next_segment(FFMPEG *ffmpeg) {
+    if (ffmpeg->segment != NULL) {
+        // Let the full segment drain into its encoder in the background
+        ffmpeg->finishers = realloc(ffmpeg->finishers, (ffmpeg->finishers_count + 1) * sizeof(*ffmpeg->finishers));
+        assert(ffmpeg->finishers != NULL && "Buy MORE RAM lol!!");
+        FFMPEG_Finisher *finisher = malloc(sizeof(*finisher));
+        assert(finisher != NULL && "Buy MORE RAM lol!!");
+        finisher->ffmpeg = ffmpeg->segment;
+        finisher->ok = false;
+        ffmpeg->segment = NULL;
+        if (pthread_create(&finisher->thread, NULL, ffmpeg_finisher_thread, finisher) != 0) {
+            // No thread to hand it to: wait for the pending ones first so none
+            // of them is lost, then drain this segment on the calling thread
+            while (ffmpeg->finishers_joined < ffmpeg->finishers_count) {
+                ffmpeg_join_finisher(ffmpeg);
+            }
+            if (!ffmpeg_end_rendering(finisher->ffmpeg, false)) ffmpeg->segments_failed = true;
+            free(finisher);
+        } else {
+            ffmpeg->finishers[ffmpeg->finishers_count++] = finisher;
+        }
+        ffmpeg->segment_index += 1;
+    }
+
+    // Backpressure: at most segment_parallel encoders are alive at the same time
+    size_t parallel = ffmpeg->settings.segment_parallel > 0 ? ffmpeg->settings.segment_parallel : 1;
+    while (ffmpeg->finishers_count - ffmpeg->finishers_joined + 1 > parallel) {
+        ffmpeg_join_finisher(ffmpeg);
+    }
+    if (ffmpeg->segments_failed) return false;
+
+    char path[PATH_MAX];
+    ffmpeg_segment_path(ffmpeg->output_path, ffmpeg->segment_index, path, sizeof(path));
+    FFMPEG_Settings settings = ffmpeg->settings;
+    settings.output_path = path;
+    settings.segment_frames = 0;
+    ffmpeg->segment = ffmpeg_start_rendering(&settings);
+    ffmpeg->segment_sent = 0;
+    if (ffmpeg->segment == NULL) return false;
+    ffmpeg->segment->stats_owner = ffmpeg;
+    return true;
+}
+
+static void ffmpeg_remove_segments(FFMPEG *ffmpeg) {
+    char path[PATH_MAX];
+    for (size_t i = 0; i <= ffmpeg->segment_index; ++i) {
+        ffmpeg_segment_path(ffmpeg->output_path, i, path, sizeof(path));
+        unlink(path);
+    }
+}
 
+// Writes a `file` line of a concat list. Inside the quotes of the concat
+// demuxer a ' has to be closed, escaped and reopened as '\''
+static void ffmpeg_write_list_file(FILE *list, const char *path) {
+    fputs("file '", list);
+    for (const char *c = path; *c != '\0'; ++c) {
+        if (*c == '\'') {
+            fputs("'\\''", list);
+        } else {
+            fputc(*c, list);
+        }
+    }
+    fputs("'\n", list);
+}
+
+// Stitches the part files together without re-encoding using ffmpeg's concat demuxer
+static bool ffmpeg_concat_segments(FFMPEG *ffmpeg) {
+    char list_path[PATH_MAX];
+    snprintf(list_path, sizeof(list_path), "%s.segments.txt", ffmpeg->output_path);
+    FILE *list = fopen(list_path, "w");
+    if (list == NULL) {
+        TraceLog(LOG_ERROR, "FFMPEG: could not create %s: %s", list_path, strerror(errno));
+        return false;
+    }
+    char path[PATH_MAX];
+    for (size_t i = 0; i <= ffmpeg->segment_index; ++i) {
+        ffmpeg_segment_path(ffmpeg->output_path, i, path, sizeof(path));
+        // Paths in the list are relative to the list itself
+        const char *name = strrchr(path, '/');
+        ffmpeg_write_list_file(list, name != NULL ? name + 1 : path);
+    }
+    fclose(list);
+
+    pid_t child = fork();
+    if (child < 0) {
+        TraceLog(LOG_ERROR, "FFMPEG: Could not fork a child: %s", strerror(errno));
+        unlink(list_path);
+        return false;
+    }
+    if (child == 0) {
+        execlp("ffmpeg", "ffmpeg", "-loglevel", "warning", "-y",
+               "-f", "concat", "-safe", "0", "-i", list_path,
+               "-c", "copy", ffmpeg->output_path, NULL);
+        TraceLog(LOG_ERROR, "FFMPEG CHILD: Could not run ffmpeg as a child process: %s", strerror(errno));
+        exit(1);
+    }
+    bool ok = ffmpeg_wait(child);
+    unlink(list_path);
+    return ok;
+}
+
+static bool ffmpeg_end_segments(FFMPEG *ffmpeg, bool cancel) {
+    if (ffmpeg->segment != NULL) {
+        if (!ffmpeg_end_rendering(ffmpeg->segment, cancel)) ffmpeg->segments_failed = true;
+    }
+    while (ffmpeg->finishers_joined < ffmpeg->finishers_count) {
+        ffmpeg_join_finisher(ffmpeg);
+    }
+
+    bool ok = !cancel && !ffmpeg->segments_failed && ffmpeg_concat_segments(ffmpeg);
+    // Keep the parts around if stitching failed, they are still usable
+    if (ok || cancel) ffmpeg_remove_segments(ffmpeg);
+
+    free(ffmpeg->finishers);
+    free(ffmpeg->output_path);
+    pthread_mutex_destroy(&ffmpeg->stats_mutex);
     free(ffmpeg);
-    
-    if (close(pipe) < 0) {
-        TraceLog(LOG_WARNING, "FFMPEG: could not close write end of the pipe on the parent's end: %s", strerror(errno));
+    return ok;
+}
+
+FFMPEG *ffmpeg_start_rendering(const FFMPEG_Settings *settings) {
+    if (settings->segment_frames > 0 && settings->sink == FFMPEG_SINK_PIPE) {
+        FFMPEG *ffmpeg = calloc(1, sizeof(FFMPEG));
+        assert(ffmpeg != NULL && "Buy MORE RAM lol!!");
+        ffmpeg->settings = *settings;
+        ffmpeg->output_path = strdup(settings->output_path);
+        assert(ffmpeg->output_path != NULL && "Buy MORE RAM lol!!");
+        ffmpeg->settings.output_path = ffmpeg->output_path;
+        ffmpeg->width = settings->width;
+        ffmpeg->height = settings->height;
+        ffmpeg->stats_owner = ffmpeg;
+        pthread_mutex_init(&ffmpeg->stats_mutex, NULL);
+        if (!ffmpeg_next_segment(ffmpeg)) {
+            pthread_mutex_destroy(&ffmpeg->stats_mutex);
+            free(ffmpeg->output_path);
+            free(ffmpeg);
+            return NULL;
+        }
+        return ffmpeg;
     }
 
-    if (cancel) kill(pid, SIGKILL);
+    FFMPEG *ffmpeg = calloc(1, sizeof(FFMPEG));
+    assert(ffmpeg != NULL && "Buy MORE RAM lol!!");
+    ffmpeg->sink = settings->sink;
+    ffmpeg->width = settings->width;
+    ffmpeg->height = settings->height;
+    ffmpeg->fps = settings->fps;
+    ffmpeg->stats_owner = ffmpeg;
+    // Y4M only carries planar YUV
+    ffmpeg->yuv420p = settings->yuv420p || settings->sink == FFMPEG_SINK_Y4M;
 
+    if (ffmpeg->sink == FFMPEG_SINK_PIPE) {
+        if (!ffmpeg_spawn(settings, ffmpeg->yuv420p, &ffmpeg->fd, &ffmpeg->pid)) {
+            free(ffmpeg);
+            return NULL;
+        }
+        ffmpeg->pipe_size = ffmpeg_grow_pipe(ffmpeg->fd, ffmpeg_frame_size(ffmpeg));
+        ffmpeg->zero_copy = settings->zero_copy && ffmpeg->pipe_size > 0;
+    } else {
+        if (!ffmpeg_open_file(ffmpeg, settings->output_path)) {
+            free(ffmpeg);
+            return NULL;
+        }
+    }
+    pthread_mutex_init(&ffmpeg->stats_mutex, NULL);
+
+    if (ffmpeg->yuv420p) ffmpeg->yuv_pool = settings->yuv_pool;
+    if (settings->queue_depth > 0) ffmpeg_start_writer(ffmpeg, settings->queue_depth);
+    if (ffmpeg->yuv420p && !ffmpeg->has_writer) {
+        ffmpeg->yuv_scratch = malloc(ffmpeg_frame_size(ffmpeg));
+        assert(ffmpeg->yuv_scratch != NULL && "Buy MORE RAM lol!!");
+    }
+
+    return ffmpeg;
+}
+
+static bool ffmpeg_wait(pid_t pid) {
     for (;;) {
         int wstatus = 0;
         if (waitpid(pid, &wstatus, 0) < 0) {
@@ -123,13 +685,193 @@ bool ffmpeg_end_rendering(FFMPEG *ffmpeg, bool cancel) {
     assert(0 && "Unreachable");
 }
 
+bool ffmpeg_end_rendering(FFMPEG *ffmpeg, bool cancel) {
+    if (ffmpeg->settings.segment_frames > 0) return ffmpeg_end_segments(ffmpeg, cancel);
+
+    // Let the writer flush the queued frames (or drop them on cancel) before closing the pipe
+    ffmpeg_stop_writer(ffmpeg, cancel);
+
+    bool ok = true;
+    if (ffmpeg->sink == FFMPEG_SINK_RAW && ftruncate(ffmpeg->fd, ffmpeg->raw_offset) < 0) {
+        // Drop the preallocated tail past the last frame
+        TraceLog(LOG_ERROR, "FFMPEG: could not truncate the raw output file: %s", strerror(errno));
+        ok = false;
+    }
+
+    if (close(ffmpeg->fd) < 0) {
+        TraceLog(LOG_WARNING, "FFMPEG: could not close the output of the rendering: %s", strerror(errno));
+    }
+
+    if (ffmpeg->sink == FFMPEG_SINK_PIPE) {
+        if (cancel) kill(ffmpeg->pid, SIGKILL);
+        ok = ffmpeg_wait(ffmpeg->pid) && ok;
+    }
+
+    ffmpeg_free_slots(ffmpeg);
+    free(ffmpeg->yuv_scratch);
+    pthread_mutex_destroy(&ffmpeg->stats_mutex);
+    free(ffmpeg);
+
+    return ok;
+}
+
+void ffmpeg_get_stats(FFMPEG *ffmpeg, FFMPEG_Stats *stats) {
+    pthread_mutex_lock(&ffmpeg->stats_mutex);
+    *stats = ffmpeg->stats;
+    pthread_mutex_unlock(&ffmpeg->stats_mutex);
+
+    // Only the segment currently receiving frames has a backlog worth reporting
+    FFMPEG *queue = ffmpeg->settings.segment_frames > 0 ? ffmpeg->segment : ffmpeg;
+    stats->queued = 0;
+    if (queue != NULL && queue->has_writer) {
+        pthread_mutex_lock(&queue->mutex);
+        stats->queued = queue->count;
+        pthread_mutex_unlock(&queue->mutex);
+    }
+}
+
+// Fills a slot with the frame, converting it to I420 on the way if requested
+static void ffmpeg_fill_slot(FFMPEG *ffmpeg, FFMPEG_Slot *slot, void *data, bool flipped) {
+    TRACE_SCOPE("ffmpeg_fill_slot");
+    slot->size = ffmpeg_frame_size(ffmpeg);
+    if (ffmpeg->yuv420p) {
+        rgba_to_yuv420p(data, ffmpeg->width, ffmpeg->height, flipped, slot->data, ffmpeg->yuv_pool);
+        slot->flipped = false;
+    } else {
+        memcpy(slot->data, data, slot->size);
+        slot->flipped = flipped;
+    }
+}
+
+static bool ffmpeg_send(FFMPEG *ffmpeg, void *data, size_t width, size_t height, bool flipped) {
+    if (width != ffmpeg->width || height != ffmpeg->height) {
+        TraceLog(LOG_ERROR, "FFMPEG: frame size %zux%zu does not match the rendering size %zux%zu", width, height, ffmpeg->width, ffmpeg->height);
+        return false;
+    }
+
+    if (ffmpeg->settings.segment_frames > 0) {
+        if (ffmpeg->segment_sent == ffmpeg->settings.segment_frames && !ffmpeg_next_segment(ffmpeg)) return false;
+        ffmpeg->segment_sent += 1;
+        return ffmpeg_send(ffmpeg->segment, data, width, height, flipped);
+    }
+
+    if (!ffmpeg->has_writer) {
+        FFMPEG_Slot slot = { .data = data, .size = ffmpeg_frame_size(ffmpeg), .flipped = flipped };
+        double start = ffmpeg_now();
+        if (ffmpeg->yuv420p) {
+            slot.data = ffmpeg->yuv_scratch;
+            ffmpeg_fill_slot(ffmpeg, &slot, data, flipped);
+        }
+        double converted = ffmpeg_now();
+        trace_begin("ffmpeg_write_slot");
+        bool ok = ffmpeg_write_slot(ffmpeg, slot, false);
+        trace_end();
+        if (!ok) return false;
+        ffmpeg_stats_add(ffmpeg, 1, 1, converted - start, 0, ffmpeg_now() - converted);
+        return true;
+    }
+
+    // Backpressure: wait for the writer to free a slot when the queue is full
+    double start = ffmpeg_now();
+    pthread_mutex_lock(&ffmpeg->mutex);
+    if (ffmpeg->count == ffmpeg->depth && !ffmpeg->failed) {
+        trace_begin("ffmpeg queue full");
+        while (ffmpeg->count == ffmpeg->depth && !ffmpeg->failed) {
+            pthread_cond_wait(&ffmpeg->can_push, &ffmpeg->mutex);
+        }
+        trace_end();
+    }
+    bool failed = ffmpeg->failed;
+    size_t tail = (ffmpeg->head + ffmpeg->count) % ffmpeg->depth;
+    pthread_mutex_unlock(&ffmpeg->mutex);
+    if (failed) return false;
+
+    // Only this thread touches the tail slot until it is published below
+    double pushed = ffmpeg_now();
+    ffmpeg_fill_slot(ffmpeg, &ffmpeg->slots[tail], data, flipped);
+    ffmpeg_stats_add(ffmpeg, 1, 0, ffmpeg_now() - pushed, pushed - start, 0);
+
+    pthread_mutex_lock(&ffmpeg->mutex);
+    ffmpeg->count += 1;
+    pthread_cond_signal(&ffmpeg->can_pop);
+    pthread_mutex_unlock(&ffmpeg->mutex);
+
+    return true;
+}
+
+bool ffmpeg_send_frame(FFMPEG *ffmpeg, void *data, size_t width, size_t height) {
+    return ffmpeg_send(ffmpeg, data, width, height, false);
+}
+
 bool ffmpeg_send_frame_flipped(FFMPEG *ffmpeg, void *data, size_t width, size_t height) {
-    for (size_t y = height; y > 0; --y) {
-        if (write(ffmpeg->pipe, (uint32_t*)data + (y - 1) * width, sizeof(uint32_t) * width) < 0) {
-            TraceLog(LOG_ERROR, "FFMPEG: failed to write frame into ffmpeg pipe: %s", strerror(errno));
-            return false;
+    return ffmpeg_send(ffmpeg, data, width, height, true);
+}
+
+static bool ffmpeg_write(FFMPEG *ffmpeg, void *data, size_t width, size_t height, bool flipped, bool owned) {
+    // Flipped rows are submitted bottom-up in batches of at most IOV_MAX, so a 4K
+    // frame costs a handful of writev() calls instead of one write() per scanline.
+    // A top-down frame is a single contiguous iovec.
+    struct iovec iov[FFMPEG_IOV_BATCH];
+    size_t row_size = sizeof(uint32_t) * width;
+
+    if (!flipped) {
+        iov[0].iov_base = data;
+        iov[0].iov_len = row_size * height;
+        return ffmpeg_write_all(ffmpeg, iov, 1, owned);
+    }
+
+    size_t y = height;
+    while (y > 0) {
+        size_t count = 0;
+        while (y > 0 && count < FFMPEG_IOV_BATCH) {
+            iov[count].iov_base = (uint32_t*)data + (y - 1) * width;
+            iov[count].iov_len = row_size;
+            count += 1;
+            y -= 1;
         }
+        if (!ffmpeg_write_all(ffmpeg, iov, count, owned)) return false;
     }
     return true;
 }
 
+static bool ffmpeg_write_all(FFMPEG *ffmpeg, struct iovec *iov, size_t count, bool owned) {
+    if (ffmpeg->raw_map != NULL) {
+        for (size_t i = 0; i < count; ++i) {
+            memcpy(ffmpeg->raw_cursor, iov[i].iov_base, iov[i].iov_len);
+            ffmpeg->raw_cursor += iov[i].iov_len;
+        }
+        return true;
+    }
+
+    while (count > 0) {
+        ssize_t n = 0;
+        if (owned && ffmpeg->zero_copy) {
+            n = vmsplice(ffmpeg->fd, iov, count, SPLICE_F_GIFT);
+            if (n < 0 && (errno == EINVAL || errno == ENOSYS)) {
+                TraceLog(LOG_WARNING, "FFMPEG: vmsplice() is not available, falling back to plain writes: %s", strerror(errno));
+                ffmpeg->zero_copy = false;
+                continue;
+            }
+        } else {
+            n = writev(ffmpeg->fd, iov, count);
+        }
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            TraceLog(LOG_ERROR, "FFMPEG: failed to write frame into the output: %s", strerror(errno));
+            return false;
+        }
+
+        // Short write: skip the fully written chunks and resume in the middle of the partial one
+        size_t written = (size_t)n;
+        while (count > 0 && written >= iov->iov_len) {
+            written -= iov->iov_len;
+            iov += 1;
+            count -= 1;
+        }
+        if (count > 0) {
+            iov->iov_base = (uint8_t*)iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+    return true;
+}
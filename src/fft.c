@@ -0,0 +1,157 @@
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include "fft.h"
+
+// Mixed-radix decimation in time, after the structure of KISS FFT
+#define FFT_MAX_FACTORS 32
+#define FFT_MAX_GENERIC_RADIX 64
+
+struct Fft {
+    size_t n;
+    // Pairs of (radix, remaining length), the last remaining length is 1
+    size_t factors[2*FFT_MAX_FACTORS];
+    Fft_Complex *twiddles;
+};
+
+static inline Fft_Complex cmul(Fft_Complex a, Fft_Complex b) {
+    return (Fft_Complex){ a.re*b.re - a.im*b.im, a.re*b.im + a.im*b.re };
+}
+
+static inline Fft_Complex cadd(Fft_Complex a, Fft_Complex b) {
+    return (Fft_Complex){ a.re + b.re, a.im + b.im };
+}
+
+static inline Fft_Complex csub(Fft_Complex a, Fft_Complex b) {
+    return (Fft_Complex){ a.re - b.re, a.im - b.im };
+}
+
+static void fft_factor(size_t n, size_t *factors) {
+    size_t p = 4;
+    double floor_sqrt = floor(sqrt((double)n));
+    do {
+        while (n % p) {
+            switch (p) {
+            case 4: p = 2; break;
+            case 2: p = 3; break;
+            default: p += 2; break;
+            }
+            if (p > floor_sqrt) p = n;
+        }
+        n /= p;
+        *factors++ = p;
+        *factors++ = n;
+    } while (n > 1);
+}
+
+Fft *fft_start(size_t n) {
+    assert(n > 0);
+    Fft *fft = calloc(1, sizeof(Fft));
+    assert(fft != NULL && "Buy MORE RAM lol!!");
+    fft->n = n;
+    fft->twiddles = malloc(n * sizeof(*fft->twiddles));
+    assert(fft->twiddles != NULL && "Buy MORE RAM lol!!");
+    for (size_t k = 0; k < n; ++k) {
+        double phase = -2.0 * M_PI * (double)k / (double)n;
+        fft->twiddles[k] = (Fft_Complex){ cos(phase), sin(phase) };
+    }
+    if (n > 1) {
+        fft_factor(n, fft->factors);
+    } else {
+        fft->factors[0] = 1;
+        fft->factors[1] = 1;
+    }
+    return fft;
+}
+
+void fft_end(Fft *fft) {
+    free(fft->twiddles);
+    free(fft);
+}
+
+size_t fft_size(const Fft *fft) {
+    return fft->n;
+}
+
+static void fft_butterfly2(const Fft *fft, Fft_Complex *out, size_t fstride, size_t m) {
+    Fft_Complex *out2 = out + m;
+    const Fft_Complex *tw = fft->twiddles;
+    for (size_t k = 0; k < m; ++k) {
+        Fft_Complex t = cmul(out2[k], *tw);
+        tw += fstride;
+        out2[k] = csub(out[k], t);
+        out[k] = cadd(out[k], t);
+    }
+}
+
+static void fft_butterfly4(const Fft *fft, Fft_Complex *out, size_t fstride, size_t m) {
+    const Fft_Complex *tw1 = fft->twiddles;
+    const Fft_Complex *tw2 = fft->twiddles;
+    const Fft_Complex *tw3 = fft->twiddles;
+    for (size_t k = 0; k < m; ++k) {
+        Fft_Complex s0 = cmul(out[k + m], *tw1);
+        Fft_Complex s1 = cmul(out[k + 2*m], *tw2);
+        Fft_Complex s2 = cmul(out[k + 3*m], *tw3);
+        tw1 += fstride;
+        tw2 += 2*fstride;
+        tw3 += 3*fstride;
+
+        Fft_Complex s5 = csub(out[k], s1);
+        out[k] = cadd(out[k], s1);
+        Fft_Complex s3 = cadd(s0, s2);
+        Fft_Complex s4 = csub(s0, s2);
+        out[k + 2*m] = csub(out[k], s3);
+        out[k] = cadd(out[k], s3);
+        out[k + m] = (Fft_Complex){ s5.re + s4.im, s5.im - s4.re };
+        out[k + 3*m] = (Fft_Complex){ s5.re - s4.im, s5.im + s4.re };
+    }
+}
+
+static void fft_butterfly_generic(const Fft *fft, Fft_Complex *out, size_t fstride, size_t m, size_t p) {
+    // Large prime factors are correct but slow, O(n * p)
+    Fft_Complex stack_scratch[FFT_MAX_GENERIC_RADIX];
+    Fft_Complex *scratch = stack_scratch;
+    if (p > FFT_MAX_GENERIC_RADIX) {
+        scratch = malloc(p * sizeof(*scratch));
+        assert(scratch != NULL && "Buy MORE RAM lol!!");
+    }
+    for (size_t u = 0; u < m; ++u) {
+        for (size_t q = 0, k = u; q < p; ++q, k += m) scratch[q] = out[k];
+        for (size_t q1 = 0, k = u; q1 < p; ++q1, k += m) {
+            size_t twiddle = 0;
+            Fft_Complex sum = scratch[0];
+            for (size_t q = 1; q < p; ++q) {
+                twiddle += fstride * k;
+                if (twiddle >= fft->n) twiddle %= fft->n;
+                sum = cadd(sum, cmul(scratch[q], fft->twiddles[twiddle]));
+            }
+            out[k] = sum;
+        }
+    }
+    if (scratch != stack_scratch) free(scratch);
+}
+
+static void fft_work(const Fft *fft, Fft_Complex *out, const Fft_Complex *in, size_t fstride, const size_t *factors) {
+    size_t p = factors[0];
+    size_t m = factors[1];
+    Fft_Complex *out_begin = out;
+    Fft_Complex *out_end = out + p*m;
+
+    if (m == 1) {
+        for (; out != out_end; ++out, in += fstride) *out = *in;
+    } else {
+        for (; out != out_end; out += m, in += fstride) fft_work(fft, out, in, fstride*p, factors + 2);
+    }
+
+    switch (p) {
+    case 1: break;
+    case 2: fft_butterfly2(fft, out_begin, fstride, m); break;
+    case 4: fft_butterfly4(fft, out_begin, fstride, m); break;
+    default: fft_butterfly_generic(fft, out_begin, fstride, m, p); break;
+    }
+}
+
+void fft_forward(const Fft *fft, const Fft_Complex *in, Fft_Complex *out) {
+    fft_work(fft, out, in, 1, fft->factors);
+}
@@ -0,0 +1,22 @@
+#ifndef FFT_H_
+#define FFT_H_
+
+#include <stddef.h>
+
+typedef struct {
+    float re;
+    float im;
+} Fft_Complex;
+
+// Forward complex FFT of any length, fast for lengths made of small primes
+// (2, 3, 5, ...), e.g. 960 = 2^6 * 3 * 5 or 1080 = 2^3 * 3^3 * 5.
+// For the inverse transform conjugate the input and the output.
+typedef struct Fft Fft;
+
+Fft *fft_start(size_t n);
+void fft_end(Fft *fft);
+size_t fft_size(const Fft *fft);
+// out = FFT(in), in and out must not overlap, both are strided by 1
+void fft_forward(const Fft *fft, const Fft_Complex *in, Fft_Complex *out);
+
+#endif // FFT_H_
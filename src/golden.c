@@ -0,0 +1,393 @@
+// Golden-image regression check of the plugins: renders deterministic frames
+// (fixed seed, fixed dt) of every plugin offscreen and compares them with the
+// reference PNGs in GOLDEN_DIR. Failed frames get a heatmap of the difference
+// written next to the reference. Plugins with several backends also get every
+// backend compared against their reference backend. Meant to run under Mesa's
+// llvmpipe (LIBGL_ALWAYS_SOFTWARE=1) so the references do not depend on a GPU.
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <unistd.h>
+
+#include "raylib.h"
+
+#include <dlfcn.h>
+
+#define NOB_IMPLEMENTATION
+#include "nob.h"
+#include "plug.h"
+#include "image_diff.h"
+
+#define GOLDEN_DIR "./golden/"
+#define GOLDEN_PLUG_DIR "./build/"
+#define GOLDEN_WIDTH 640
+#define GOLDEN_HEIGHT 360
+#define GOLDEN_FPS 60
+#define GOLDEN_SEED 69
+// Default largest per-channel difference that still counts as equal
+#define GOLDEN_DEFAULT_TOLERANCE 2
+
+// Frames of every plugin compared against a reference
+static const size_t golden_checkpoints[] = {1, 30, 120};
+
+// Alternative backends of a plugin, selected through an environment variable
+// at plug_init(). Every backend renders GOLDEN_BACKEND_FRAMES frames from the
+// same seed and has to match the reference backend within
+// GOLDEN_BACKEND_TOLERANCE, except for at most GOLDEN_BACKEND_MISMATCH of
+// the pixels where float rounding got amplified by the steep growth function.
+#define GOLDEN_BACKEND_FRAMES 30
+#define GOLDEN_BACKEND_TOLERANCE 8
+#define GOLDEN_BACKEND_MISMATCH 0.001
+typedef struct {
+    const char *name;
+    const char *value;
+} Golden_Env;
+
+typedef struct {
+    const char *plug;
+    const char *variable;
+    const char *reference;
+    const char *backends[8];
+    // Set for the reference and every backend alike
+    Golden_Env setup[4];
+} Golden_Backends;
+
+static const Golden_Backends golden_backends[] = {
+    {
+        .plug = "smoothlife",
+        .variable = "SMOOTHLIFE_BACKEND",
+        .reference = "shader",
+        .backends = {"spans", "fft", "cpu", "cpu-spans"},
+        // A small float grid keeps the CPU backends fast and the half float
+        // state of the GPU backends out of the comparison
+        .setup = {{"SMOOTHLIFE_SIZE", "320x180"}, {"SMOOTHLIFE_STATE", "float"}},
+    },
+};
+
+static void *libplug = NULL;
+
+// Keeps stdout clean for the report
+static void log_to_stderr(int log_level, const char *text, va_list args) {
+    (void)log_level;
+    vfprintf(stderr, text, args);
+    fprintf(stderr, "\n");
+}
+
+static bool load_libplug(const char *libplug_path) {
+    if (libplug != NULL) {
+        dlclose(libplug);
+    }
+
+    libplug = dlopen(libplug_path, RTLD_NOW);
+    if (libplug == NULL) {
+        fprintf(stderr, "ERROR: %s\n", dlerror());
+        return false;
+    }
+
+    #define PLUG(name, ...) \
+        name = dlsym(libplug, #name); \
+        if (name == NULL) { \
+            fprintf(stderr, "ERROR: %s\n", dlerror()); \
+            return false; \
+        }
+    LIST_OF_PLUGS
+    #undef PLUG
+
+    return true;
+}
+
+// Gives the plugin's GPU resources and state back before the next one is loaded
+static void unload_libplug(void) {
+    if (libplug == NULL) return;
+    free(plug_pre_reload());
+    dlclose(libplug);
+    libplug = NULL;
+}
+
+static int compare_paths(const void *a, const void *b) {
+    return strcmp(*(const char**)a, *(const char**)b);
+}
+
+// Every lib*.so in the build directory that exports the plugin interface
+static bool find_plugs(Nob_File_Paths *plugs) {
+    Nob_File_Paths children = {0};
+    if (!nob_read_entire_dir(GOLDEN_PLUG_DIR, &children)) return false;
+    for (size_t i = 0; i < children.count; ++i) {
+        const char *name = children.items[i];
+        if (strncmp(name, "lib", 3) != 0 || !nob_sv_end_with(nob_sv_from_cstr(name), ".so")) continue;
+        const char *path = nob_temp_sprintf(GOLDEN_PLUG_DIR"%s", name);
+        void *lib = dlopen(path, RTLD_LAZY);
+        if (lib == NULL) continue;
+        if (dlsym(lib, "plug_update") != NULL) nob_da_append(plugs, path);
+        dlclose(lib);
+    }
+    qsort(plugs->items, plugs->count, sizeof(*plugs->items), compare_paths);
+    return true;
+}
+
+// ./build/libgrowin.so -> growin
+static const char *plug_name(const char *path) {
+    const char *name = strrchr(path, '/');
+    name = name != NULL ? name + 1 : path;
+    if (strncmp(name, "lib", 3) == 0) name += 3;
+    const char *dot = strchr(name, '.');
+    return nob_temp_sprintf("%.*s", dot != NULL ? (int)(dot - name) : (int)strlen(name), name);
+}
+
+// Pixels within tolerance show the reference dimmed, the others go from red to yellow with the difference
+static Image heatmap(Image reference, const uint8_t *heat, uint8_t tolerance) {
+    Image image = ImageCopy(reference);
+    uint8_t *pixels = image.data;
+    for (int i = 0; i < image.width * image.height; ++i) {
+        uint8_t *p = &pixels[4*i];
+        if (heat[i] <= tolerance) {
+            uint8_t gray = (p[0] + p[1] + p[2]) / 12;
+            p[0] = p[1] = p[2] = gray;
+        } else {
+            p[0] = 255;
+            p[1] = heat[i];
+            p[2] = 0;
+        }
+        p[3] = 255;
+    }
+    return image;
+}
+
+static Image capture(RenderTexture2D target) {
+    Image image = LoadImageFromTexture(target.texture);
+    ImageFormat(&image, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+    // Render textures are stored bottom row first
+    ImageFlipVertical(&image);
+    return image;
+}
+
+// Returns whether the frame matches its reference, or got stored as the reference with update.
+// A frame without a reference fails, unless allow_missing skips it.
+static bool check_frame(Image actual, const char *name, size_t frame, bool update, bool allow_missing, uint8_t tolerance, Thread_Pool *pool) {
+    const char *reference_path = nob_temp_sprintf(GOLDEN_DIR"%s_%04zu.png", name, frame);
+    if (update) {
+        if (!ExportImage(actual, reference_path)) {
+            fprintf(stderr, "ERROR: could not write %s\n", reference_path);
+            return false;
+        }
+        printf("UPDATED %s\n", reference_path);
+        return true;
+    }
+
+    if (!FileExists(reference_path)) {
+        printf("%s %s: no reference, run with --update to create it\n", allow_missing ? "SKIP" : "FAIL", reference_path);
+        return allow_missing;
+    }
+    Image reference = LoadImage(reference_path);
+    ImageFormat(&reference, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+    if (reference.width != actual.width || reference.height != actual.height) {
+        printf("FAIL %s: reference is %dx%d, rendered %dx%d\n", reference_path, reference.width, reference.height, actual.width, actual.height);
+        UnloadImage(reference);
+        return false;
+    }
+
+    uint8_t *heat = malloc((size_t)actual.width * actual.height);
+    assert(heat != NULL && "Buy MORE RAM lol!!");
+    Image_Diff diff = image_diff_rgba(reference.data, actual.data, actual.width, actual.height, tolerance, heat, pool);
+    bool ok = diff.mismatched == 0;
+    if (ok) {
+        printf("OK %s (max diff %d)\n", reference_path, diff.max_diff);
+    } else {
+        const char *actual_path = nob_temp_sprintf(GOLDEN_DIR"%s_%04zu.actual.png", name, frame);
+        const char *heatmap_path = nob_temp_sprintf(GOLDEN_DIR"%s_%04zu.diff.png", name, frame);
+        Image heat_image = heatmap(reference, heat, tolerance);
+        ExportImage(actual, actual_path);
+        ExportImage(heat_image, heatmap_path);
+        UnloadImage(heat_image);
+        printf("FAIL %s: %zu pixels differ by up to %d, see %s\n", reference_path, diff.mismatched, diff.max_diff, heatmap_path);
+    }
+    free(heat);
+    UnloadImage(reference);
+    return ok;
+}
+
+// Loads the plugin and starts it from the fixed seed
+static bool start_plug(const char *path) {
+    if (!load_libplug(path)) return false;
+
+    // Plugins draw from both raylib's and libc's generator
+    SetRandomSeed(GOLDEN_SEED);
+    srand(GOLDEN_SEED);
+    plug_init();
+    SetRandomSeed(GOLDEN_SEED);
+    srand(GOLDEN_SEED);
+    plug_reset();
+    return true;
+}
+
+static bool check_plug(const char *path, bool update, bool allow_missing, uint8_t tolerance, Thread_Pool *pool) {
+    if (!start_plug(path)) return false;
+    const char *name = plug_name(path);
+
+    RenderTexture2D target = LoadRenderTexture(GOLDEN_WIDTH, GOLDEN_HEIGHT);
+    bool ok = true;
+    size_t frame = 0;
+    for (size_t i = 0; i < NOB_ARRAY_LEN(golden_checkpoints); ++i) {
+        while (frame < golden_checkpoints[i]) {
+            BeginTextureMode(target);
+            plug_update(1.0f/GOLDEN_FPS, GOLDEN_WIDTH, GOLDEN_HEIGHT, true);
+            EndTextureMode();
+            frame += 1;
+        }
+        Image actual = capture(target);
+        if (!check_frame(actual, name, frame, update, allow_missing, tolerance, pool)) ok = false;
+        UnloadImage(actual);
+    }
+    UnloadRenderTexture(target);
+    unload_libplug();
+    return ok;
+}
+
+// Renders frame GOLDEN_BACKEND_FRAMES of the plugin from a fresh start with
+// the backend selected by variable=backend
+static bool render_backend(const char *path, const Golden_Backends *backends, const char *backend, Image *image) {
+    setenv(backends->variable, backend, 1);
+    if (!start_plug(path)) return false;
+    RenderTexture2D target = LoadRenderTexture(GOLDEN_WIDTH, GOLDEN_HEIGHT);
+    for (size_t frame = 0; frame < GOLDEN_BACKEND_FRAMES; ++frame) {
+        BeginTextureMode(target);
+        plug_update(1.0f/GOLDEN_FPS, GOLDEN_WIDTH, GOLDEN_HEIGHT, true);
+        EndTextureMode();
+    }
+    *image = capture(target);
+    UnloadRenderTexture(target);
+    unload_libplug();
+    return true;
+}
+
+// Returns whether every alternative backend of the plugin matches its reference backend
+static bool check_backends(const char *path, Thread_Pool *pool) {
+    const char *name = plug_name(path);
+    const Golden_Backends *backends = NULL;
+    for (size_t i = 0; i < NOB_ARRAY_LEN(golden_backends); ++i) {
+        if (strcmp(golden_backends[i].plug, name) == 0) backends = &golden_backends[i];
+    }
+    if (backends == NULL) return true;
+
+    for (size_t i = 0; i < NOB_ARRAY_LEN(backends->setup) && backends->setup[i].name != NULL; ++i) {
+        setenv(backends->setup[i].name, backends->setup[i].value, 1);
+    }
+
+    bool ok = true;
+    Image reference = {0};
+    if (!render_backend(path, backends, backends->reference, &reference)) ok = false;
+    for (size_t i = 0; ok && i < NOB_ARRAY_LEN(backends->backends) && backends->backends[i] != NULL; ++i) {
+        const char *backend = backends->backends[i];
+        Image actual = {0};
+        if (!render_backend(path, backends, backend, &actual)) {
+            ok = false;
+            break;
+        }
+        Image_Diff diff = image_diff_rgba(reference.data, actual.data, actual.width, actual.height, GOLDEN_BACKEND_TOLERANCE, NULL, pool);
+        size_t allowed = (size_t)(GOLDEN_BACKEND_MISMATCH * actual.width * actual.height);
+        if (diff.mismatched <= allowed) {
+            printf("OK %s %s=%s matches %s at frame %d (max diff %d, %zu pixels off)\n",
+                   name, backends->variable, backend, backends->reference, GOLDEN_BACKEND_FRAMES, diff.max_diff, diff.mismatched);
+        } else {
+            const char *actual_path = nob_temp_sprintf(GOLDEN_DIR"%s_%s_%04d.actual.png", name, backend, GOLDEN_BACKEND_FRAMES);
+            ExportImage(actual, actual_path);
+            printf("FAIL %s %s=%s: %zu pixels differ from %s by up to %d at frame %d, see %s\n",
+                   name, backends->variable, backend, diff.mismatched, backends->reference, diff.max_diff, GOLDEN_BACKEND_FRAMES, actual_path);
+            ok = false;
+        }
+        UnloadImage(actual);
+    }
+    if (reference.data != NULL) UnloadImage(reference);
+
+    unsetenv(backends->variable);
+    for (size_t i = 0; i < NOB_ARRAY_LEN(backends->setup) && backends->setup[i].name != NULL; ++i) {
+        unsetenv(backends->setup[i].name);
+    }
+    return ok;
+}
+
+static void usage(const char *program_name) {
+    fprintf(stderr, "Usage: %s [OPTIONS] [libplug.so...]\n", program_name);
+    fprintf(stderr, "Checks every plugin in "GOLDEN_PLUG_DIR" against the references in "GOLDEN_DIR" unless some are given.\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "    --update                 Store the rendered frames as the new references\n");
+    fprintf(stderr, "    --allow-missing          Skip frames without a reference instead of failing\n");
+    fprintf(stderr, "    --tolerance <0-255>      Largest per-channel difference still accepted (default: %d)\n", GOLDEN_DEFAULT_TOLERANCE);
+}
+
+int main(int argc, char **argv) {
+    const char *program_name = nob_shift_args(&argc, &argv);
+
+    bool update = false;
+    bool allow_missing = false;
+    unsigned long tolerance = GOLDEN_DEFAULT_TOLERANCE;
+    while (argc > 0 && strncmp(argv[0], "--", 2) == 0) {
+        const char *flag = nob_shift_args(&argc, &argv);
+        if (strcmp(flag, "--update") == 0) {
+            update = true;
+            continue;
+        }
+        if (strcmp(flag, "--allow-missing") == 0) {
+            allow_missing = true;
+            continue;
+        }
+        if (argc <= 0) {
+            usage(program_name);
+            fprintf(stderr, "ERROR: no value is provided for %s\n", flag);
+            return 1;
+        }
+        const char *value = nob_shift_args(&argc, &argv);
+
+        if (strcmp(flag, "--tolerance") == 0) {
+            tolerance = strtoul(value, NULL, 10);
+            if (tolerance > 255) {
+                fprintf(stderr, "ERROR: invalid tolerance %s\n", value);
+                return 1;
+            }
+        } else {
+            usage(program_name);
+            fprintf(stderr, "ERROR: unknown option %s\n", flag);
+            return 1;
+        }
+    }
+
+    Nob_File_Paths plugs = {0};
+    while (argc > 0) nob_da_append(&plugs, nob_shift_args(&argc, &argv));
+    if (plugs.count == 0 && !find_plugs(&plugs)) return 1;
+    if (plugs.count == 0) {
+        fprintf(stderr, "ERROR: no plugins found in "GOLDEN_PLUG_DIR"\n");
+        return 1;
+    }
+    if (!nob_mkdir_if_not_exists(GOLDEN_DIR)) return 1;
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    Thread_Pool *pool = thread_pool_start(cpus > 0 ? cpus : 1, "diff worker");
+
+    SetTraceLogCallback(log_to_stderr);
+    SetTraceLogLevel(LOG_WARNING);
+    SetConfigFlags(FLAG_WINDOW_HIDDEN);
+    InitWindow(GOLDEN_WIDTH, GOLDEN_HEIGHT, "Shader Animation Golden Images");
+    if (!IsWindowReady()) {
+        fprintf(stderr, "ERROR: could not create an OpenGL context\n");
+        thread_pool_end(pool);
+        return 1;
+    }
+
+    size_t failed = 0;
+    for (size_t i = 0; i < plugs.count; ++i) {
+        bool ok = check_plug(plugs.items[i], update, allow_missing, tolerance, pool);
+        // Backends are compared with each other, there is nothing to update
+        if (!update && !check_backends(plugs.items[i], pool)) ok = false;
+        if (!ok) failed += 1;
+    }
+    // A plugin that failed to load is still open
+    if (libplug != NULL) dlclose(libplug);
+    CloseWindow();
+    thread_pool_end(pool);
+
+    if (failed > 0) {
+        printf("%zu of %zu plugins failed\n", failed, plugs.count);
+        return 1;
+    }
+    return 0;
+}
@@ -21,6 +21,7 @@ typedef struct {
     int timeLoc;
     int resolutionLoc;
     int originLoc;
+    int tileOffsetLoc;
 } Info;
 
 typedef struct {
@@ -29,22 +30,26 @@ typedef struct {
     float time;
     int timeLoc;
     int resolutionLoc;
+    int tileOffsetLoc;
     Info info;
     size_t size;
 } Plug;
 
 static Plug *p = NULL;
+static Vector2 tile_offset = {0};
 
 static void load_resources(void) {
     p->font = LoadFontEx("./assets/fonts/iosevka-regular.ttf", FONT_SIZE, NULL, 0);
     p->shader = LoadShader(0, "./assets/shaders/growin.fs");
     p->timeLoc = GetShaderLocation(p->shader, "u_time");
     p->resolutionLoc = GetShaderLocation(p->shader, "u_resolution");
+    p->tileOffsetLoc = GetShaderLocation(p->shader, "u_tile_offset");
 
     p->info.shader = LoadShader(0, "./assets/shaders/info.fs");
     p->info.timeLoc = GetShaderLocation(p->info.shader, "u_time");
     p->info.resolutionLoc = GetShaderLocation(p->info.shader, "u_resolution");
     p->info.originLoc = GetShaderLocation(p->info.shader, "u_origin");
+    p->info.tileOffsetLoc = GetShaderLocation(p->info.shader, "u_tile_offset");
     p->info.text = "Made by realsanjeev";
 
     if (p->info.originLoc == -1) {
@@ -62,6 +67,11 @@ void plug_reset(void) {
     p->time = 0.0f;
 }
 
+// Offset of gl_FragCoord when main renders the frame in tiles, see tiled.h
+void plug_set_tile(float x, float y) {
+    tile_offset = (Vector2){x, y};
+}
+
 void plug_init(void) {
     if (!p) {
         p = calloc(1, sizeof(Plug));
@@ -138,6 +148,7 @@ void plug_update(float dt, float w, float h) {
     BeginShaderMode(p->shader);
     SetShaderValue(p->shader, p->timeLoc, &p->time, SHADER_UNIFORM_FLOAT);
     SetShaderValue(p->shader, p->resolutionLoc, resolution, SHADER_UNIFORM_VEC2);
+    SetShaderValue(p->shader, p->tileOffsetLoc, &tile_offset, SHADER_UNIFORM_VEC2);
     DrawRectangle(0, 0, w, h, WHITE);
     EndShaderMode();
 
@@ -157,6 +168,7 @@ void plug_update(float dt, float w, float h) {
     SetShaderValue(p->info.shader, p->info.timeLoc, &p->time, SHADER_UNIFORM_FLOAT);
     SetShaderValue(p->info.shader, p->info.resolutionLoc, infoResolution, SHADER_UNIFORM_VEC2);
     SetShaderValue(p->info.shader, p->info.originLoc, origin, SHADER_UNIFORM_VEC2);
+    SetShaderValue(p->info.shader, p->info.tileOffsetLoc, &tile_offset, SHADER_UNIFORM_VEC2);
     DrawRectangleRec(textBounds, BLANK);
     EndShaderMode();
 
@@ -0,0 +1,113 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "image_diff.h"
+
+typedef struct {
+    const uint8_t *a;
+    const uint8_t *b;
+    size_t width;
+    uint8_t tolerance;
+    uint8_t *heat;
+    // One partial result per band, summed up once all of them are done
+    Image_Diff *results;
+} Image_Diff_Job;
+
+static inline uint8_t abs_diff(uint8_t x, uint8_t y) {
+    return x > y ? x - y : y - x;
+}
+
+// Returns the mismatched pixels of the row, and raises *max_diff
+static size_t diff_row(const uint8_t *a, const uint8_t *b, size_t width, uint8_t tolerance, uint8_t *heat, uint8_t *max_diff) {
+    size_t mismatched = 0;
+    size_t x = 0;
+
+#if defined(__SSE2__)
+    // 4 pixels at a time: |a - b| per channel from two saturating
+    // subtractions, then the maximum over the 4 channels of every pixel
+    __m128i row_max = _mm_setzero_si128();
+    __m128i limit = _mm_set1_epi8((char)tolerance);
+    for (; x + 4 <= width; x += 4) {
+        __m128i va = _mm_loadu_si128((const __m128i*)(a + 4*x));
+        __m128i vb = _mm_loadu_si128((const __m128i*)(b + 4*x));
+        __m128i diff = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+        row_max = _mm_max_epu8(row_max, diff);
+
+        __m128i pixel = _mm_max_epu8(diff, _mm_srli_epi32(diff, 16));
+        pixel = _mm_max_epu8(pixel, _mm_srli_epi32(pixel, 8));
+        pixel = _mm_and_si128(pixel, _mm_set1_epi32(0xFF));
+
+        // Channels within tolerance have max(diff, tolerance) == tolerance
+        __m128i within = _mm_cmpeq_epi8(_mm_max_epu8(diff, limit), limit);
+        int mask = _mm_movemask_epi8(within);
+        for (int i = 0; i < 4; ++i) {
+            if (((mask >> 4*i) & 0xF) != 0xF) mismatched += 1;
+        }
+
+        if (heat != NULL) {
+            __m128i packed = _mm_packs_epi32(pixel, pixel);
+            packed = _mm_packus_epi16(packed, packed);
+            int value = _mm_cvtsi128_si32(packed);
+            heat[x + 0] = value;
+            heat[x + 1] = value >> 8;
+            heat[x + 2] = value >> 16;
+            heat[x + 3] = value >> 24;
+        }
+    }
+    uint8_t lanes[16];
+    _mm_storeu_si128((__m128i*)lanes, row_max);
+    for (size_t i = 0; i < 16; ++i) {
+        if (lanes[i] > *max_diff) *max_diff = lanes[i];
+    }
+#endif
+
+    for (; x < width; ++x) {
+        uint8_t pixel = 0;
+        for (size_t c = 0; c < 4; ++c) {
+            uint8_t diff = abs_diff(a[4*x + c], b[4*x + c]);
+            if (diff > pixel) pixel = diff;
+        }
+        if (pixel > tolerance) mismatched += 1;
+        if (pixel > *max_diff) *max_diff = pixel;
+        if (heat != NULL) heat[x] = pixel;
+    }
+    return mismatched;
+}
+
+static void diff_band(void *user, size_t begin, size_t end, size_t band) {
+    Image_Diff_Job *job = user;
+    Image_Diff *result = &job->results[band];
+    size_t stride = 4 * job->width;
+    for (size_t y = begin; y < end; ++y) {
+        result->mismatched += diff_row(job->a + y * stride, job->b + y * stride, job->width, job->tolerance,
+                                       job->heat != NULL ? job->heat + y * job->width : NULL,
+                                       &result->max_diff);
+    }
+}
+
+Image_Diff image_diff_rgba(const uint8_t *a, const uint8_t *b, size_t width, size_t height, uint8_t tolerance, uint8_t *heat, Thread_Pool *pool) {
+    size_t threads = thread_pool_threads(pool);
+    Image_Diff_Job job = {
+        .a = a,
+        .b = b,
+        .width = width,
+        .tolerance = tolerance,
+        .heat = heat,
+        .results = calloc(threads, sizeof(Image_Diff)),
+    };
+    assert(job.results != NULL && "Buy MORE RAM lol!!");
+    thread_pool_run(pool, diff_band, &job, height);
+
+    Image_Diff result = {0};
+    for (size_t i = 0; i < threads; ++i) {
+        result.mismatched += job.results[i].mismatched;
+        if (job.results[i].max_diff > result.max_diff) result.max_diff = job.results[i].max_diff;
+    }
+    free(job.results);
+    return result;
+}
@@ -0,0 +1,22 @@
+#ifndef IMAGE_DIFF_H_
+#define IMAGE_DIFF_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "thread_pool.h"
+
+typedef struct {
+    // Pixels with at least one channel off by more than the tolerance
+    size_t mismatched;
+    // Largest per-channel difference over the whole image
+    uint8_t max_diff;
+} Image_Diff;
+
+// Compares two RGBA8 images of the same size channel by channel. If heat is
+// not NULL it receives width*height bytes with the largest channel
+// difference of every pixel. The rows are split into bands compared on
+// `pool` (NULL compares on the calling thread).
+Image_Diff image_diff_rgba(const uint8_t *a, const uint8_t *b, size_t width, size_t height, uint8_t tolerance, uint8_t *heat, Thread_Pool *pool);
+
+#endif // IMAGE_DIFF_H_
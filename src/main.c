@@ -1,8 +1,12 @@
 #include <stdio.h>
 #include <stdint.h>
+#include <limits.h>
 #include <math.h>
+#include <ctype.h>
+#include <errno.h>
 
 #include "raylib.h"
+#include "rlgl.h"
 
 #include <dlfcn.h>
 
@@ -10,16 +14,71 @@
 #include "nob.h"
 #include "plug.h"
 #include "ffmpeg.h"
+#include "readback.h"
+#include "render_stats.h"
+#include "trace.h"
+#include "tiled.h"
+#include "png_stream.h"
+#include "capture_pool.h"
+#include "accum.h"
 
 #define FFMPEG_VIDEO_WIDTH (1920*2)
 #define FFMPEG_VIDEO_HEIGHT (1080*2)
 #define FFMPEG_VIDEO_FPS 60
-#define FFMPEG_VIDEO_DELTA_TIME (1.0f/FFMPEG_VIDEO_FPS)
+#define FFMPEG_VIDEO_QUEUE_DEPTH 4
+#define FFMPEG_VIDEO_READBACK_DEPTH 3
+// Convert frames to yuv420p before piping them into ffmpeg
+#define FFMPEG_VIDEO_YUV420P true
+// Splice queued frames into the ffmpeg pipe instead of copying them
+#define FFMPEG_VIDEO_ZERO_COPY true
+// Maximum amount of ffmpeg processes encoding segments at the same time
+#define FFMPEG_VIDEO_SEGMENT_PARALLEL 4
+// Flip frames on the GPU while reading them back instead of on the CPU
+#define READBACK_TOP_DOWN true
+// Stills are rendered in tiles of at most this size (or the driver's maximum texture size)
+#define CAPTURE_TILE_SIZE 4096
+// Background threads encoding the S and C captures, and how many captures may wait for them
+#define CAPTURE_POOL_WORKERS 2
+#define CAPTURE_POOL_DEPTH 4
 #define RENDERING_FONT_SIZE 78
+// While rendering video only redraw the "Rendering Video" preview this often (in seconds)
+#define RENDERING_PREVIEW_INTERVAL 0.1
 
 // The state of Panim Engine
 static bool paused = false;
 static FFMPEG *ffmpeg = NULL;
+// Video rendering options collected from the command line
+static size_t video_width = FFMPEG_VIDEO_WIDTH;
+static size_t video_height = FFMPEG_VIDEO_HEIGHT;
+static size_t video_fps = FFMPEG_VIDEO_FPS;
+// Batch mode renders video_frames frames (or until plug_finished()) without a visible window
+static bool batch_render = false;
+static size_t video_frames = 0;
+// Batch mode rendering a single still of video_width x video_height after video_frames frames
+static const char *capture_path = NULL;
+static Capture_Pool *capture_pool = NULL;
+static FFMPEG_Settings video_settings = {
+    .sink = FFMPEG_SINK_PIPE,
+    .segment_parallel = FFMPEG_VIDEO_SEGMENT_PARALLEL,
+};
+static struct {
+    const char **items;
+    size_t count;
+    size_t capacity;
+} video_extra_args = {0};
+static Readback *readback = NULL;
+// The file the current rendering actually goes to, it differs from the
+// requested one when the pipe falls back to Y4M
+static char video_output_path[PATH_MAX];
+// Jittered samples and motion blur subframes accumulated into every video frame
+static size_t accum_samples = 1;
+static size_t accum_subframes = 1;
+static Accum *accum = NULL;
+static Render_Stats *render_stats = NULL;
+// Where to write the JSON summary of a rendering, NULL to only log it
+static const char *render_stats_path = NULL;
+// Where to dump the Chrome trace of the session, NULL disables tracing
+static const char *trace_path = NULL;
 static RenderTexture2D screen = {0};
 static Font rendering_font = {0};
 static void *libplug = NULL;
@@ -47,11 +106,192 @@ static bool reload_libplug(const char *libplug_path) {
     return true;
 }
 
-static void finish_ffmpeg_rendering(bool cancel) {
+static bool send_frame(void *pixels) {
+    if (readback_is_top_down(readback)) {
+        return ffmpeg_send_frame(ffmpeg, pixels, video_width, video_height);
+    }
+    return ffmpeg_send_frame_flipped(ffmpeg, pixels, video_width, video_height);
+}
+
+static void accum_draw(void *user, size_t width, size_t height, float jitter_x, float jitter_y, float dt) {
+    (void) user;
+    plug_set_tile(jitter_x, jitter_y);
+    plug_update(dt, width, height, true);
+}
+
+static bool render_video_frame(void) {
+    TRACE_SCOPE("render_video_frame");
+    double start = GetTime();
+    trace_begin("plug_update");
+    if (accum != NULL) {
+        accum_render(accum, screen, 1.0f/video_fps, accum_draw, NULL);
+        plug_set_tile(0, 0);
+    } else {
+        BeginTextureMode(screen);
+        plug_update(1.0f/video_fps, video_width, video_height, true);
+        EndTextureMode();
+    }
+    trace_end();
+    double updated = GetTime();
+    render_stats_add(render_stats, RENDER_STAGE_UPDATE, updated - start);
+
+    // NULL while the readback ring is still filling up
+    trace_begin("readback_frame");
+    void *pixels = NULL;
+    bool ok = readback_frame(readback, screen.id, &pixels);
+    trace_end();
+    double read = GetTime();
+    render_stats_add(render_stats, RENDER_STAGE_READBACK, read - updated);
+
+    trace_begin("send_frame");
+    // A frame that could not be read back would leave a hole in the video
+    ok = ok && (pixels == NULL || send_frame(pixels));
+    trace_end();
+    render_stats_add(render_stats, RENDER_STAGE_SEND, GetTime() - read);
+    render_stats_frame(render_stats, ffmpeg);
+    return ok;
+}
+
+typedef struct {
+    float dt;
+    // PNGs are compressed while the tiles come in, other formats go through ExportImage
+    Png_Stream *png;
+    // Interactive captures are compressed by capture_pool instead
+    Capture_Stream *stream;
+    uint8_t *pixels;
+    size_t rows;
+} Capture;
+
+static void capture_draw_tile(void *user, size_t width, size_t height, float offset_x, float offset_y, bool first) {
+    Capture *capture = user;
+    plug_set_tile(offset_x, offset_y);
+    plug_update(first ? capture->dt : 0.0f, width, height, true);
+}
+
+static bool capture_rows(void *user, const uint8_t *rows, size_t width, size_t count) {
+    Capture *capture = user;
+    if (capture->stream != NULL) return capture_stream_rows(capture->stream, rows, count);
+    if (capture->png != NULL) return png_stream_rows(capture->png, rows, count);
+    memcpy(capture->pixels + 4 * width * capture->rows, rows, 4 * width * count);
+    capture->rows += count;
+    return true;
+}
+
+// Renders a still in tiles, so it can be larger than the GPU's maximum texture size
+static bool capture_still(const char *path, size_t width, size_t height, float dt) {
+    TRACE_SCOPE("capture_still");
+    Capture capture = { .dt = dt };
+    size_t tile_size = tiled_tile_size(CAPTURE_TILE_SIZE);
+    if (IsFileExtension(path, ".png")) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        Thread_Pool *pool = thread_pool_start(cpus > 0 ? cpus : 1, "capture deflate");
+        capture.png = png_stream_start(path, width, height, pool);
+        bool ok = capture.png != NULL;
+        if (ok) {
+            ok = tiled_render(width, height, tile_size, capture_draw_tile, capture_rows, &capture);
+            plug_set_tile(0, 0);
+            ok = png_stream_end(capture.png, !ok) && ok;
+        }
+        thread_pool_end(pool);
+        return ok;
+    }
+
+    capture.pixels = malloc(4 * width * height);
+    if (capture.pixels == NULL) {
+        TraceLog(LOG_ERROR, "Not enough memory for a %zux%zu capture", width, height);
+        return false;
+    }
+    bool ok = tiled_render(width, height, tile_size, capture_draw_tile, capture_rows, &capture);
+    plug_set_tile(0, 0);
+    if (ok) {
+        Image image = {
+            .data = capture.pixels,
+            .width = width,
+            .height = height,
+            .mipmaps = 1,
+            .format = PIXELFORMAT_UNCOMPRESSED_R8G8B8A8,
+        };
+        ok = ExportImage(image, path);
+    }
+    free(capture.pixels);
+    return ok;
+}
+
+static const char *sink_output_path(FFMPEG_Sink sink) {
+    switch (sink) {
+    case FFMPEG_SINK_PIPE: return "output.mp4";
+    case FFMPEG_SINK_Y4M:  return "output.y4m";
+    case FFMPEG_SINK_RAW:  return FFMPEG_VIDEO_YUV420P ? "output.yuv" : "output.rgba";
+    }
+    assert(0 && "Unreachable");
+    return NULL;
+}
+
+static void start_ffmpeg_rendering(void) {
+    FFMPEG_Settings settings = video_settings;
+    if (settings.output_path == NULL) settings.output_path = sink_output_path(settings.sink);
+    snprintf(video_output_path, sizeof(video_output_path), "%s", settings.output_path);
+    if (settings.sink == FFMPEG_SINK_PIPE && !ffmpeg_is_available()) {
+        // Keep the requested name, only the container changes: out.mp4 becomes out.y4m
+        const char *slash = strrchr(settings.output_path, '/');
+        const char *dot = strrchr(settings.output_path, '.');
+        if (dot == NULL || (slash != NULL && dot < slash)) dot = settings.output_path + strlen(settings.output_path);
+        snprintf(video_output_path, sizeof(video_output_path), "%.*s.y4m", (int)(dot - settings.output_path), settings.output_path);
+        TraceLog(LOG_WARNING, "ffmpeg is not found in PATH, rendering into %s instead", video_output_path);
+        settings.sink = FFMPEG_SINK_Y4M;
+    }
+    settings.output_path = video_output_path;
+
+    settings.width = video_width;
+    settings.height = video_height;
+    settings.fps = video_fps;
+    settings.queue_depth = FFMPEG_VIDEO_QUEUE_DEPTH;
+    settings.yuv420p = FFMPEG_VIDEO_YUV420P;
+    settings.zero_copy = FFMPEG_VIDEO_ZERO_COPY;
+    settings.extra_args = video_extra_args.items;
+    settings.extra_args_count = video_extra_args.count;
+    ffmpeg = ffmpeg_start_rendering(&settings);
+    if (ffmpeg) {
+        readback = readback_start(video_width, video_height, FFMPEG_VIDEO_READBACK_DEPTH, READBACK_TOP_DOWN);
+        render_stats = render_stats_start(batch_render ? video_frames : 0, video_fps);
+        if (accum_samples > 1 || accum_subframes > 1) {
+            accum = accum_start(video_width, video_height, accum_samples, accum_subframes);
+        }
+    }
+}
+
+static bool finish_ffmpeg_rendering(bool cancel) {
+    TRACE_SCOPE("finish_ffmpeg_rendering");
+    double start = GetTime();
+    if (!cancel) {
+        // Frames still in flight in the readback ring belong to the video too
+        for (;;) {
+            void *pixels = NULL;
+            if (!readback_flush(readback, &pixels)) {
+                cancel = true;
+                break;
+            }
+            if (pixels == NULL) break;
+            if (!send_frame(pixels)) {
+                cancel = true;
+                break;
+            }
+        }
+    }
+
     SetTraceLogLevel(LOG_INFO);
-    ffmpeg_end_rendering(ffmpeg, cancel);
+    render_stats_sample(render_stats, ffmpeg);
+    bool ok = ffmpeg_end_rendering(ffmpeg, cancel) && !cancel;
+    render_stats_add(render_stats, RENDER_STAGE_FLUSH, GetTime() - start);
+    ok = render_stats_end(render_stats, ok, render_stats_path) && ok;
+    readback_end(readback);
+    if (accum != NULL) accum_end(accum);
     plug_reset();
     ffmpeg = NULL;
+    readback = NULL;
+    accum = NULL;
+    render_stats = NULL;
+    return ok;
 }
 
 void rendering_scene(const char *text) {
@@ -76,6 +316,11 @@ void rendering_scene(const char *text) {
     };
     DrawTextEx(rendering_font, sub_text, sub_position, sub_font_size, 0, foreground_color);
 
+    if (render_stats != NULL) {
+        float stats_font_size = RENDERING_FONT_SIZE / 3.0f;
+        render_stats_draw(render_stats, rendering_font, (Vector2){stats_font_size, stats_font_size}, stats_font_size, foreground_color);
+    }
+
     // Bouncing dots
     float circle_radius = RENDERING_FONT_SIZE * 0.2f;
     float ball_height = GetScreenHeight() * 0.03;
@@ -108,11 +353,199 @@ void rendering_scene(const char *text) {
     }
 }
 
+// Offline rendering for unattended jobs: no visible window, no vsync or
+// frame rate cap, no rendering_scene, just plug_update -> readback -> sink.
+static bool run_batch_render(void) {
+    SetConfigFlags(FLAG_WINDOW_HIDDEN);
+    InitWindow(video_width < 640 ? video_width : 640, video_height < 360 ? video_height : 360, "Shader Animation");
+    plug_init();
+    screen = LoadRenderTexture(video_width, video_height);
+
+    if (video_frames == 0) {
+        TraceLog(LOG_WARNING, "No --frames given, rendering until the animation finishes");
+    }
+
+    SetTraceLogLevel(LOG_WARNING);
+    start_ffmpeg_rendering();
+    bool ok = ffmpeg != NULL;
+    if (ok) {
+        plug_reset();
+        bool cancel = false;
+        for (size_t frame = 0; (video_frames == 0 || frame < video_frames) && !plug_finished(); ++frame) {
+            if (!render_video_frame()) {
+                cancel = true;
+                break;
+            }
+        }
+        ok = finish_ffmpeg_rendering(cancel);
+    }
+    SetTraceLogLevel(LOG_INFO);
+
+    if (ok) {
+        TraceLog(LOG_INFO, "Rendered video saved as %s", video_output_path);
+    } else {
+        TraceLog(LOG_ERROR, "Rendering into %s failed", video_output_path);
+    }
+
+    UnloadRenderTexture(screen);
+    CloseWindow();
+    return ok;
+}
+
+// Renders a single still after video_frames frames without a visible window
+static bool run_batch_capture(void) {
+    SetConfigFlags(FLAG_WINDOW_HIDDEN);
+    InitWindow(640, 360, "Shader Animation");
+    plug_init();
+    plug_reset();
+
+    // Earlier frames only advance the animation, nearly everything gets clipped away
+    RenderTexture2D scratch = LoadRenderTexture(1, 1);
+    for (size_t frame = 1; frame < video_frames; ++frame) {
+        BeginTextureMode(scratch);
+        plug_update(1.0f/video_fps, video_width, video_height, true);
+        EndTextureMode();
+    }
+    UnloadRenderTexture(scratch);
+
+    bool ok = capture_still(capture_path, video_width, video_height, video_frames > 0 ? 1.0f/video_fps : 0.0f);
+    if (ok) {
+        TraceLog(LOG_INFO, "Capture saved as %s", capture_path);
+    } else {
+        TraceLog(LOG_ERROR, "Capturing into %s failed", capture_path);
+    }
+
+    CloseWindow();
+    return ok;
+}
+
+// A decimal count without a sign or trailing junk, which strtoul() alone accepts
+static bool parse_count(const char *value, size_t *count) {
+    if (!isdigit((unsigned char)value[0])) return false;
+    char *end = NULL;
+    errno = 0;
+    unsigned long result = strtoul(value, &end, 10);
+    if (errno != 0 || *end != '\0') return false;
+    *count = result;
+    return true;
+}
+
+static void usage(const char *program_name) {
+    fprintf(stderr, "Usage: %s [OPTIONS] <libplug.so>\n", program_name);
+    fprintf(stderr, "Video rendering options:\n");
+    fprintf(stderr, "    --render <path>          Render into <path> without a visible window and exit\n");
+    fprintf(stderr, "    --capture <path>         Render a single --size still into <path> in tiles without a visible window and exit\n");
+    fprintf(stderr, "    --frames <count>         Frames to render in --render mode (default: until the animation finishes),\n");
+    fprintf(stderr, "                             or the frame to take in --capture mode (default: the first one)\n");
+    fprintf(stderr, "    --size <width>x<height>  Video resolution (default: %dx%d)\n", FFMPEG_VIDEO_WIDTH, FFMPEG_VIDEO_HEIGHT);
+    fprintf(stderr, "    --fps <fps>              Video frame rate (default: %d)\n", FFMPEG_VIDEO_FPS);
+    fprintf(stderr, "    --samples <count>        Jittered samples averaged into every video frame for anti-aliasing (default: 1)\n");
+    fprintf(stderr, "    --motion-blur <count>    Points in time averaged into every video frame (default: 1)\n");
+    fprintf(stderr, "    --output <path>          Output file (default: output.mp4/.y4m/.yuv depending on the sink)\n");
+    fprintf(stderr, "    --stats <path>           Write a JSON summary of the per-stage render timings into <path>\n");
+    fprintf(stderr, "    --trace <path>           Record a Chrome trace (chrome://tracing, Perfetto) of the session into <path>\n");
+    fprintf(stderr, "    --sink pipe|y4m|raw      Encode with ffmpeg, or write Y4M/raw frames natively\n");
+    fprintf(stderr, "    --segments <frames>      Encode every <frames> frames with a separate ffmpeg process\n");
+    fprintf(stderr, "    --codec <name>           Video codec (default: libx264)\n");
+    fprintf(stderr, "    --preset <name>          Encoder preset, e.g. ultrafast or slow (default: veryfast)\n");
+    fprintf(stderr, "    --crf <value>            Constant quality (default: 18)\n");
+    fprintf(stderr, "    --bitrate <rate>         Target bitrate instead of --crf, e.g. 8M\n");
+    fprintf(stderr, "    --pix-fmt <format>       Pixel format of the encoded video (default: yuv420p)\n");
+    fprintf(stderr, "    --threads <count>        Encoder threads (default: chosen by ffmpeg)\n");
+    fprintf(stderr, "    --ffmpeg-arg <arg>       Extra ffmpeg output argument, can be repeated\n");
+}
+
 int main(int argc, char **argv) {
     const char *program_name = nob_shift_args(&argc, &argv);
 
+    while (argc > 0 && strncmp(argv[0], "--", 2) == 0) {
+        const char *flag = nob_shift_args(&argc, &argv);
+        if (argc <= 0) {
+            usage(program_name);
+            fprintf(stderr, "ERROR: no value is provided for %s\n", flag);
+            return 1;
+        }
+        const char *value = nob_shift_args(&argc, &argv);
+
+        if (strcmp(flag, "--sink") == 0) {
+            if (strcmp(value, "pipe") == 0) {
+                video_settings.sink = FFMPEG_SINK_PIPE;
+            } else if (strcmp(value, "y4m") == 0) {
+                video_settings.sink = FFMPEG_SINK_Y4M;
+            } else if (strcmp(value, "raw") == 0) {
+                video_settings.sink = FFMPEG_SINK_RAW;
+            } else {
+                fprintf(stderr, "ERROR: unknown sink %s, expected pipe, y4m or raw\n", value);
+                return 1;
+            }
+        } else if (strcmp(flag, "--render") == 0) {
+            batch_render = true;
+            video_settings.output_path = value;
+        } else if (strcmp(flag, "--capture") == 0) {
+            capture_path = value;
+        } else if (strcmp(flag, "--frames") == 0) {
+            if (!parse_count(value, &video_frames) || video_frames == 0) {
+                fprintf(stderr, "ERROR: invalid frame count %s\n", value);
+                return 1;
+            }
+        } else if (strcmp(flag, "--size") == 0) {
+            if (sscanf(value, "%zux%zu", &video_width, &video_height) != 2 || video_width == 0 || video_height == 0) {
+                fprintf(stderr, "ERROR: invalid size %s, expected <width>x<height>\n", value);
+                return 1;
+            }
+        } else if (strcmp(flag, "--fps") == 0) {
+            if (!parse_count(value, &video_fps) || video_fps == 0) {
+                fprintf(stderr, "ERROR: invalid frame rate %s\n", value);
+                return 1;
+            }
+        } else if (strcmp(flag, "--samples") == 0) {
+            if (!parse_count(value, &accum_samples) || accum_samples == 0) {
+                fprintf(stderr, "ERROR: invalid sample count %s\n", value);
+                return 1;
+            }
+        } else if (strcmp(flag, "--motion-blur") == 0) {
+            if (!parse_count(value, &accum_subframes) || accum_subframes == 0) {
+                fprintf(stderr, "ERROR: invalid motion blur subframe count %s\n", value);
+                return 1;
+            }
+        } else if (strcmp(flag, "--output") == 0) {
+            video_settings.output_path = value;
+        } else if (strcmp(flag, "--stats") == 0) {
+            render_stats_path = value;
+        } else if (strcmp(flag, "--trace") == 0) {
+            trace_path = value;
+        } else if (strcmp(flag, "--segments") == 0) {
+            if (!parse_count(value, &video_settings.segment_frames) || video_settings.segment_frames == 0) {
+                fprintf(stderr, "ERROR: invalid segment length %s\n", value);
+                return 1;
+            }
+        } else if (strcmp(flag, "--codec") == 0) {
+            video_settings.codec = value;
+        } else if (strcmp(flag, "--preset") == 0) {
+            video_settings.preset = value;
+        } else if (strcmp(flag, "--crf") == 0) {
+            video_settings.crf = value;
+        } else if (strcmp(flag, "--bitrate") == 0) {
+            video_settings.bitrate = value;
+        } else if (strcmp(flag, "--pix-fmt") == 0) {
+            video_settings.pix_fmt = value;
+        } else if (strcmp(flag, "--threads") == 0) {
+            // 0 is ffmpeg's own "decide yourself"
+            if (!parse_count(value, &video_settings.threads)) {
+                fprintf(stderr, "ERROR: invalid thread count %s\n", value);
+                return 1;
+            }
+        } else if (strcmp(flag, "--ffmpeg-arg") == 0) {
+            nob_da_append(&video_extra_args, value);
+        } else {
+            usage(program_name);
+            fprintf(stderr, "ERROR: unknown flag %s\n", flag);
+            return 1;
+        }
+    }
+
     if (argc <= 0) {
-        fprintf(stderr, "Usage: %s <libplug.so>\n", program_name);
+        usage(program_name);
         fprintf(stderr, "ERROR: no animation dynamic library is provided\n");
         return 1;
     }
@@ -121,6 +554,24 @@ int main(int argc, char **argv) {
         
     if (!reload_libplug(libplug_path)) return 1;
 
+    if (trace_path != NULL) trace_start(trace_path);
+    trace_thread_name("main");
+
+    if (capture_path != NULL) {
+        bool ok = run_batch_capture();
+        return trace_stop() && ok ? 0 : 1;
+    }
+
+    // One pool converts the frames of every rendering and all of its segments
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    video_settings.yuv_pool = thread_pool_start(cpus > 0 ? cpus : 1, "yuv worker");
+
+    if (batch_render) {
+        bool ok = run_batch_render();
+        thread_pool_end(video_settings.yuv_pool);
+        return trace_stop() && ok ? 0 : 1;
+    }
+
     float scale_factor = 100.0f;
     SetConfigFlags(FLAG_MSAA_4X_HINT | FLAG_WINDOW_RESIZABLE);
     InitWindow(16*scale_factor, 9*scale_factor, "Shader Animation");
@@ -128,8 +579,9 @@ int main(int argc, char **argv) {
     SetExitKey(KEY_NULL);
     plug_init();
 
-    screen = LoadRenderTexture(FFMPEG_VIDEO_WIDTH, FFMPEG_VIDEO_HEIGHT);
+    screen = LoadRenderTexture(video_width, video_height);
     rendering_font = LoadFontEx("./assets/fonts/Vollkorn-Regular.ttf", RENDERING_FONT_SIZE, NULL, 0);
+    capture_pool = capture_pool_start(CAPTURE_POOL_WORKERS, CAPTURE_POOL_DEPTH);
 
     while (!WindowShouldClose()) {
         if (IsKeyPressed(KEY_Q)) {
@@ -137,32 +589,34 @@ int main(int argc, char **argv) {
             break;
         }
         
+        trace_begin("frame");
         BeginDrawing();
             if (ffmpeg) {
-                if (plug_finished() || IsKeyPressed(KEY_ESCAPE)) {
-                    finish_ffmpeg_rendering(false);
-                } else {
-                    BeginTextureMode(screen);
-                    plug_update(FFMPEG_VIDEO_DELTA_TIME, FFMPEG_VIDEO_WIDTH, FFMPEG_VIDEO_HEIGHT, true);
-                    EndTextureMode();
-
-                    Image image = LoadImageFromTexture(screen.texture);
-                    if (!ffmpeg_send_frame_flipped(ffmpeg, image.data, image.width, image.height)) {
+                // Render video frames as fast as the GPU and encoder allow and only go
+                // through EndDrawing() (frame rate cap, input polling) once per preview
+                double preview_deadline = GetTime() + RENDERING_PREVIEW_INTERVAL;
+                do {
+                    if (plug_finished() || IsKeyPressed(KEY_ESCAPE)) {
+                        finish_ffmpeg_rendering(false);
+                    } else if (!render_video_frame()) {
                         finish_ffmpeg_rendering(true);
                     }
-                    UnloadImage(image);
-                }
+                } while (ffmpeg && GetTime() < preview_deadline);
                 rendering_scene("Rendering Video");
             } else {
                 if (IsKeyPressed(KEY_R)) {
                     SetTraceLogLevel(LOG_WARNING);
-                    ffmpeg = ffmpeg_start_rendering(FFMPEG_VIDEO_WIDTH, FFMPEG_VIDEO_HEIGHT, FFMPEG_VIDEO_FPS);
+                    start_ffmpeg_rendering();
                     plug_reset();
                 } else {
                     if (IsKeyPressed(KEY_H)) {
+                        trace_begin("plug_pre_reload");
                         void *state = plug_pre_reload();
+                        trace_end();
                         reload_libplug(libplug_path);
+                        trace_begin("plug_post_reload");
                         plug_post_reload(state);
+                        trace_end();
                     }
 
                     if (IsKeyPressed(KEY_SPACE)) {
@@ -173,26 +627,34 @@ int main(int argc, char **argv) {
                         plug_reset();
                     }
 
+                    // Only the readback happens here, the workers encode and save the PNGs
                     if (IsKeyPressed(KEY_S)) {
-                        TakeScreenshot("shader_screenshot.png");
-                        TraceLog(LOG_INFO, "Shader screensshot saved as shader_screenshot.png");
+                        int width = GetRenderWidth();
+                        int height = GetRenderHeight();
+                        char path[256];
+                        capture_timestamped_path("shader_screenshot", path, sizeof(path));
+                        capture_pool_submit(capture_pool, rlReadScreenPixels(width, height), width, height, path);
                     }
 
+                    // Only the tiles are rendered and read back here, their rows stream
+                    // into a PNG on the workers so the full image is never held
                     if (IsKeyPressed(KEY_C)) {
-                        // First, render to the screen texture
-                        BeginTextureMode(screen);
-                        plug_update(paused ? 0.0f : GetFrameTime(), FFMPEG_VIDEO_WIDTH, FFMPEG_VIDEO_HEIGHT, true);
-                        EndTextureMode();
-                        // DrawTextureEx(screen.texture, (Vector2){0, 0}, 0.0f, 1.0f, WHITE);
-
-                        Image highres_image = LoadImageFromTexture(screen.texture);
-                        ImageFlipVertical(&highres_image);
-                        ExportImage(highres_image, "shader_highres_capture.png");
-                        UnloadImage(highres_image);
-                        TraceLog(LOG_INFO, "High-resolution capture saved as shader_highres_capture.png");
+                        char path[256];
+                        capture_timestamped_path("shader_highres_capture", path, sizeof(path));
+                        Capture capture = {
+                            .dt = paused ? 0.0f : GetFrameTime(),
+                            .stream = capture_pool_stream(capture_pool, path, video_width, video_height),
+                        };
+                        if (capture.stream != NULL) {
+                            bool ok = tiled_render(video_width, video_height, tiled_tile_size(CAPTURE_TILE_SIZE), capture_draw_tile, capture_rows, &capture);
+                            plug_set_tile(0, 0);
+                            capture_stream_end(capture.stream, !ok);
+                        }
                     }
                     
+                    trace_begin("plug_update");
                     plug_update(paused ? 0.0f : GetFrameTime(), GetScreenWidth(), GetScreenHeight(), false);
+                    trace_end();
 //                     BeginTextureMode(screen);
 //                         plug_update(0.2f, FFMPEG_VIDEO_WIDTH, FFMPEG_VIDEO_HEIGHT, true);
 //                         Image state_image = LoadImageFromTexture(screen.texture);
@@ -201,10 +663,16 @@ int main(int argc, char **argv) {
 //                         EndTextureMode();
                 }
             }
+        trace_begin("EndDrawing");
         EndDrawing();
+        trace_end();
+        trace_end();
     }
+    // Captures still in flight are finished before exiting
+    capture_pool_end(capture_pool);
+    thread_pool_end(video_settings.yuv_pool);
     UnloadRenderTexture(screen);
     UnloadFont(rendering_font);
     CloseWindow();
-    return 0;
+    return trace_stop() ? 0 : 1;
 }
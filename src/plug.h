@@ -8,6 +8,7 @@
     PLUG(plug_update, void, float, float, float, bool)  /* Render next frame of the animation */ \
     PLUG(plug_reset, void, void)                        /* Reset the state of the animation */ \
     PLUG(plug_finished, bool, void)                     /* Check if the animation is finished */ \
+    PLUG(plug_set_tile, void, float, float)             /* Offset of the tile the next frame renders, see tiled.h */ \
 
 #define PLUG(name, ret, ...) ret (*name)(__VA_ARGS__);
 LIST_OF_PLUGS
@@ -0,0 +1,275 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <zlib.h>
+
+#include <raylib.h>
+#include "png_stream.h"
+
+// Uncompressed bytes deflated by one thread at a time
+#define PNG_STREAM_CHUNK_BYTES (1024*1024)
+#define PNG_STREAM_LEVEL 6
+
+typedef struct {
+    // Input: `count` raw rows and the row above them, NULL for the first row of the image
+    const uint8_t *rows;
+    const uint8_t *above;
+    size_t count;
+    bool last;
+
+    // Output: filtered rows, their deflate blocks and their adler32
+    uint8_t *filtered;
+    size_t filtered_size;
+    uint8_t *deflated;
+    size_t deflated_capacity;
+    size_t deflated_size;
+    uLong adler;
+    bool ok;
+} Png_Chunk;
+
+struct Png_Stream {
+    FILE *file;
+    char *path;
+    size_t width;
+    size_t height;
+    size_t stride;
+    size_t rows_written;
+    uLong adler;
+    bool failed;
+
+    // Rows are collected into a batch of one chunk of chunk_rows rows per
+    // thread of the pool, the whole batch is compressed in parallel once it is full
+    Thread_Pool *pool;
+    size_t threads;
+    size_t chunk_rows;
+    uint8_t *batch;
+    size_t batch_rows;
+    // Last row of the previous batch, the Paeth filter looks one row up
+    uint8_t *above;
+    bool has_above;
+    Png_Chunk *chunks;
+};
+
+static void png_put_u32(uint8_t *p, uint32_t x) {
+    p[0] = x >> 24;
+    p[1] = x >> 16;
+    p[2] = x >> 8;
+    p[3] = x;
+}
+
+static bool png_write_chunk(Png_Stream *png, const char *type, const uint8_t *data, size_t size) {
+    uint8_t header[8];
+    png_put_u32(header, size);
+    memcpy(header + 4, type, 4);
+    uLong crc = crc32(0, header + 4, 4);
+    if (size > 0) crc = crc32(crc, data, size);
+    uint8_t footer[4];
+    png_put_u32(footer, crc);
+
+    if (fwrite(header, sizeof(header), 1, png->file) != 1 ||
+        (size > 0 && fwrite(data, size, 1, png->file) != 1) ||
+        fwrite(footer, sizeof(footer), 1, png->file) != 1) {
+        TraceLog(LOG_ERROR, "PNG: could not write %s: %s", png->path, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+static inline uint8_t paeth(uint8_t a, uint8_t b, uint8_t c) {
+    int p = a + b - c;
+    int pa = abs(p - a);
+    int pb = abs(p - b);
+    int pc = abs(p - c);
+    if (pa <= pb && pa <= pc) return a;
+    if (pb <= pc) return b;
+    return c;
+}
+
+// Paeth filter for every row, it has the best ratio on the smooth gradients of the shaders
+static void png_filter_rows(Png_Chunk *chunk, size_t stride) {
+    uint8_t *out = chunk->filtered;
+    for (size_t y = 0; y < chunk->count; ++y) {
+        const uint8_t *row = chunk->rows + y * stride;
+        const uint8_t *up = y > 0 ? row - stride : chunk->above;
+        *out++ = 4;
+        for (size_t x = 0; x < stride; ++x) {
+            uint8_t a = x >= 4 ? row[x - 4] : 0;
+            uint8_t b = up != NULL ? up[x] : 0;
+            uint8_t c = x >= 4 && up != NULL ? up[x - 4] : 0;
+            *out++ = row[x] - paeth(a, b, c);
+        }
+    }
+    chunk->filtered_size = out - chunk->filtered;
+}
+
+static void png_compress_chunk(Png_Chunk *chunk, size_t stride) {
+    png_filter_rows(chunk, stride);
+    chunk->adler = adler32(adler32(0, NULL, 0), chunk->filtered, chunk->filtered_size);
+
+    // Raw deflate blocks: every chunk but the last ends on a byte boundary
+    // (Z_SYNC_FLUSH), so the chunks concatenate into one valid stream
+    z_stream z = {0};
+    chunk->ok = deflateInit2(&z, PNG_STREAM_LEVEL, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+    if (!chunk->ok) return;
+    z.next_in = chunk->filtered;
+    z.avail_in = chunk->filtered_size;
+    z.next_out = chunk->deflated;
+    z.avail_out = chunk->deflated_capacity;
+    int ret = deflate(&z, chunk->last ? Z_FINISH : Z_SYNC_FLUSH);
+    chunk->ok = (chunk->last ? ret == Z_STREAM_END : ret == Z_OK) && z.avail_in == 0;
+    chunk->deflated_size = chunk->deflated_capacity - z.avail_out;
+    deflateEnd(&z);
+}
+
+static void png_compress_chunks(void *user, size_t begin, size_t end, size_t band) {
+    (void) band;
+    Png_Stream *png = user;
+    for (size_t i = begin; i < end; ++i) png_compress_chunk(&png->chunks[i], png->stride);
+}
+
+Png_Stream *png_stream_start(const char *path, size_t width, size_t height, Thread_Pool *pool) {
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        TraceLog(LOG_ERROR, "PNG: could not create %s: %s", path, strerror(errno));
+        return NULL;
+    }
+
+    Png_Stream *png = calloc(1, sizeof(Png_Stream));
+    assert(png != NULL && "Buy MORE RAM lol!!");
+    png->file = file;
+    png->path = strdup(path);
+    assert(png->path != NULL && "Buy MORE RAM lol!!");
+    png->width = width;
+    png->height = height;
+    png->stride = 4 * width;
+    png->adler = adler32(0, NULL, 0);
+
+    size_t threads = thread_pool_threads(pool);
+    png->pool = pool;
+    png->threads = threads;
+    png->chunk_rows = PNG_STREAM_CHUNK_BYTES / (png->stride + 1);
+    if (png->chunk_rows < 1) png->chunk_rows = 1;
+
+    png->batch = malloc(threads * png->chunk_rows * png->stride);
+    png->above = malloc(png->stride);
+    png->chunks = calloc(threads, sizeof(Png_Chunk));
+    assert(png->batch != NULL && png->above != NULL && png->chunks != NULL && "Buy MORE RAM lol!!");
+    size_t filtered_capacity = png->chunk_rows * (png->stride + 1);
+    for (size_t i = 0; i < threads; ++i) {
+        Png_Chunk *chunk = &png->chunks[i];
+        chunk->filtered = malloc(filtered_capacity);
+        // deflateBound() covers Z_FINISH, a sync flush adds an empty stored block on top
+        chunk->deflated_capacity = compressBound(filtered_capacity) + 16;
+        chunk->deflated = malloc(chunk->deflated_capacity);
+        assert(chunk->filtered != NULL && chunk->deflated != NULL && "Buy MORE RAM lol!!");
+    }
+
+    static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    uint8_t ihdr[13] = {0};
+    png_put_u32(ihdr + 0, width);
+    png_put_u32(ihdr + 4, height);
+    ihdr[8] = 8;   // Bit depth
+    ihdr[9] = 6;   // RGBA
+    // zlib stream header: deflate with a 32K window, default compression
+    static const uint8_t zlib_header[2] = {0x78, 0x9C};
+    if (fwrite(signature, sizeof(signature), 1, file) != 1 ||
+        !png_write_chunk(png, "IHDR", ihdr, sizeof(ihdr)) ||
+        !png_write_chunk(png, "IDAT", zlib_header, sizeof(zlib_header))) {
+        png_stream_end(png, true);
+        return NULL;
+    }
+    return png;
+}
+
+// Compresses the collected rows on the pool and appends them to the file in order
+static bool png_flush_batch(Png_Stream *png) {
+    if (png->batch_rows == 0) return true;
+
+    size_t count = (png->batch_rows + png->chunk_rows - 1) / png->chunk_rows;
+    bool last_batch = png->rows_written == png->height;
+    for (size_t i = 0; i < count; ++i) {
+        Png_Chunk *chunk = &png->chunks[i];
+        size_t first_row = i * png->chunk_rows;
+        chunk->rows = png->batch + first_row * png->stride;
+        chunk->above = first_row > 0 ? chunk->rows - png->stride : (png->has_above ? png->above : NULL);
+        chunk->count = png->batch_rows - first_row < png->chunk_rows ? png->batch_rows - first_row : png->chunk_rows;
+        chunk->last = last_batch && i + 1 == count;
+    }
+    thread_pool_run(png->pool, png_compress_chunks, png, count);
+
+    for (size_t i = 0; i < count; ++i) {
+        Png_Chunk *chunk = &png->chunks[i];
+        if (!chunk->ok) {
+            TraceLog(LOG_ERROR, "PNG: could not compress %s", png->path);
+            return false;
+        }
+        if (!png_write_chunk(png, "IDAT", chunk->deflated, chunk->deflated_size)) return false;
+        png->adler = adler32_combine(png->adler, chunk->adler, chunk->filtered_size);
+    }
+
+    memcpy(png->above, png->batch + (png->batch_rows - 1) * png->stride, png->stride);
+    png->has_above = true;
+    png->batch_rows = 0;
+    return true;
+}
+
+bool png_stream_rows(Png_Stream *png, const uint8_t *rows, size_t count) {
+    if (png->failed) return false;
+    if (png->rows_written + count > png->height) {
+        TraceLog(LOG_ERROR, "PNG: %s only has %zu rows", png->path, png->height);
+        png->failed = true;
+        return false;
+    }
+
+    size_t batch_capacity = png->threads * png->chunk_rows;
+    while (count > 0) {
+        size_t n = batch_capacity - png->batch_rows;
+        if (n > count) n = count;
+        memcpy(png->batch + png->batch_rows * png->stride, rows, n * png->stride);
+        png->batch_rows += n;
+        png->rows_written += n;
+        rows += n * png->stride;
+        count -= n;
+
+        if (png->batch_rows == batch_capacity || png->rows_written == png->height) {
+            if (!png_flush_batch(png)) {
+                png->failed = true;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool png_stream_end(Png_Stream *png, bool cancel) {
+    bool ok = !cancel && !png->failed;
+    if (ok && png->rows_written != png->height) {
+        TraceLog(LOG_ERROR, "PNG: %s got %zu of its %zu rows", png->path, png->rows_written, png->height);
+        ok = false;
+    }
+    if (ok) {
+        uint8_t adler[4];
+        png_put_u32(adler, png->adler);
+        ok = png_write_chunk(png, "IDAT", adler, sizeof(adler)) && png_write_chunk(png, "IEND", NULL, 0);
+    }
+    if (fclose(png->file) != 0 && ok) {
+        TraceLog(LOG_ERROR, "PNG: could not write %s: %s", png->path, strerror(errno));
+        ok = false;
+    }
+    if (!ok) unlink(png->path);
+
+    for (size_t i = 0; i < png->threads; ++i) {
+        free(png->chunks[i].filtered);
+        free(png->chunks[i].deflated);
+    }
+    free(png->chunks);
+    free(png->batch);
+    free(png->above);
+    free(png->path);
+    free(png);
+    return ok;
+}
@@ -0,0 +1,24 @@
+#ifndef PNG_STREAM_H_
+#define PNG_STREAM_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "thread_pool.h"
+
+// Writes an RGBA8 PNG incrementally from bands of rows, so huge images never
+// have to be in memory at once. Rows are grouped into chunks that are
+// filtered and deflated on the threads of `pool` (NULL deflates on the
+// calling thread) independently of each other (pigz style) and appended to
+// the file in order. Memory use is bounded by about 2 * threads *
+// PNG_STREAM_CHUNK_BYTES. The pool has to outlive the stream.
+typedef struct Png_Stream Png_Stream;
+
+Png_Stream *png_stream_start(const char *path, size_t width, size_t height, Thread_Pool *pool);
+// Appends `count` top-down rows of `width` RGBA8 pixels
+bool png_stream_rows(Png_Stream *png, const uint8_t *rows, size_t count);
+// Finishes the file, fails if fewer than `height` rows were written. cancel removes the file.
+bool png_stream_end(Png_Stream *png, bool cancel);
+
+#endif // PNG_STREAM_H_
@@ -0,0 +1,180 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+#include <raylib.h>
+#include <rlgl.h>
+#include "readback.h"
+
+struct Readback {
+    size_t width;
+    size_t height;
+    size_t size;
+
+    // Synchronous fallback
+    void *pixels;
+
+    // Flipped copy of the source framebuffer when reading top-down
+    bool top_down;
+    RenderTexture2D flipped;
+
+    // PBO ring: frames [head, head + count) are in flight
+    GLuint *pbos;
+    size_t pbo_count;
+    size_t head;
+    size_t count;
+    // A buffer stays mapped without being bound, so other reads of the
+    // framebuffer (screenshots) are not redirected into it
+    GLuint mapped;
+};
+
+static bool readback_pbo_supported(void) {
+    int version = rlGetVersion();
+    return version == RL_OPENGL_33 || version == RL_OPENGL_43;
+}
+
+// glBlitFramebuffer needs the same OpenGL 3.0+ context as PBOs
+static bool readback_blit_supported(void) {
+    return readback_pbo_supported();
+}
+
+static void readback_unmap(Readback *readback) {
+    if (readback->mapped == 0) return;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback->mapped);
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    readback->mapped = 0;
+}
+
+static bool readback_map_oldest(Readback *readback, void **pixels) {
+    GLuint pbo = readback->pbos[readback->head];
+    readback->head = (readback->head + 1) % readback->pbo_count;
+    readback->count -= 1;
+
+    // Errors left over from other code would be reported as ours
+    while (glGetError() != GL_NO_ERROR);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+    *pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, readback->size, GL_MAP_READ_BIT);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    if (*pixels == NULL) {
+        TraceLog(LOG_ERROR, "READBACK: could not map pixel buffer object %u: GL error 0x%04X", pbo, glGetError());
+        return false;
+    }
+    readback->mapped = pbo;
+    return true;
+}
+
+Readback *readback_start(size_t width, size_t height, size_t pbo_count, bool top_down) {
+    Readback *readback = calloc(1, sizeof(Readback));
+    assert(readback != NULL && "Buy MORE RAM lol!!");
+    readback->width = width;
+    readback->height = height;
+    readback->size = sizeof(uint32_t) * width * height;
+
+    if (top_down) {
+        if (readback_blit_supported()) {
+            readback->flipped = LoadRenderTexture(width, height);
+            readback->top_down = readback->flipped.id != 0;
+        }
+        if (!readback->top_down) {
+            TraceLog(LOG_WARNING, "READBACK: framebuffer blit is not available, frames will be read bottom-up");
+        }
+    }
+
+    if (pbo_count >= 2 && readback_pbo_supported()) {
+        readback->pbos = calloc(pbo_count, sizeof(GLuint));
+        assert(readback->pbos != NULL && "Buy MORE RAM lol!!");
+        glGenBuffers(pbo_count, readback->pbos);
+        for (size_t i = 0; i < pbo_count; ++i) {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, readback->pbos[i]);
+            glBufferData(GL_PIXEL_PACK_BUFFER, readback->size, NULL, GL_STREAM_READ);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        if (glGetError() == GL_NO_ERROR) {
+            readback->pbo_count = pbo_count;
+            TraceLog(LOG_INFO, "READBACK: using a ring of %zu pixel buffer objects", pbo_count);
+            return readback;
+        }
+
+        TraceLog(LOG_WARNING, "READBACK: pixel buffer objects are not usable, falling back to synchronous readback");
+        glDeleteBuffers(pbo_count, readback->pbos);
+        free(readback->pbos);
+        readback->pbos = NULL;
+    }
+
+    readback->pixels = malloc(readback->size);
+    assert(readback->pixels != NULL && "Buy MORE RAM lol!!");
+    return readback;
+}
+
+bool readback_is_top_down(Readback *readback) {
+    return readback->top_down;
+}
+
+bool readback_frame(Readback *readback, unsigned int framebuffer, void **pixels) {
+    *pixels = NULL;
+    readback_unmap(readback);
+
+    // Make sure everything batched for the target actually reached the GPU
+    rlDrawRenderBatchActive();
+
+    if (readback->top_down) {
+        // Swapping the destination rows makes the GPU do the vertical flip
+        GLint w = readback->width;
+        GLint h = readback->height;
+        rlBindFramebuffer(RL_READ_FRAMEBUFFER, framebuffer);
+        rlBindFramebuffer(RL_DRAW_FRAMEBUFFER, readback->flipped.id);
+        glBlitFramebuffer(0, 0, w, h, 0, h, w, 0, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        rlBindFramebuffer(RL_DRAW_FRAMEBUFFER, 0);
+        framebuffer = readback->flipped.id;
+    }
+
+    rlBindFramebuffer(RL_READ_FRAMEBUFFER, framebuffer);
+    GLint alignment = 4;
+    glGetIntegerv(GL_PACK_ALIGNMENT, &alignment);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+    if (readback->pbos == NULL) {
+        glReadPixels(0, 0, readback->width, readback->height, GL_RGBA, GL_UNSIGNED_BYTE, readback->pixels);
+        glPixelStorei(GL_PACK_ALIGNMENT, alignment);
+        rlBindFramebuffer(RL_READ_FRAMEBUFFER, 0);
+        *pixels = readback->pixels;
+        return true;
+    }
+
+    // With a PBO bound glReadPixels only schedules the copy and returns immediately
+    size_t tail = (readback->head + readback->count) % readback->pbo_count;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback->pbos[tail]);
+    glReadPixels(0, 0, readback->width, readback->height, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glPixelStorei(GL_PACK_ALIGNMENT, alignment);
+    rlBindFramebuffer(RL_READ_FRAMEBUFFER, 0);
+    readback->count += 1;
+
+    if (readback->count < readback->pbo_count) return true;
+    return readback_map_oldest(readback, pixels);
+}
+
+bool readback_flush(Readback *readback, void **pixels) {
+    *pixels = NULL;
+    readback_unmap(readback);
+    if (readback->count == 0) return true;
+    return readback_map_oldest(readback, pixels);
+}
+
+void readback_end(Readback *readback) {
+    readback_unmap(readback);
+    if (readback->top_down) UnloadRenderTexture(readback->flipped);
+    if (readback->pbos != NULL) {
+        glDeleteBuffers(readback->pbo_count, readback->pbos);
+        free(readback->pbos);
+    }
+    free(readback->pixels);
+    free(readback);
+}
@@ -0,0 +1,30 @@
+#ifndef READBACK_H_
+#define READBACK_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// GPU -> CPU readback of a render target into memory owned by the
+// rendering session, so rendering a video does no per-frame allocations.
+typedef struct Readback Readback;
+
+// pbo_count is the length of the pixel buffer object ring. With 2 or more
+// PBOs frame N is copied out while frame N+1 renders; 0 or 1 (or a driver
+// without PBO support) falls back to a synchronous glReadPixels.
+// top_down asks for the vertical flip to be done on the GPU with a blit, so
+// no CPU pass over the pixels is needed just to fix the orientation.
+Readback *readback_start(size_t width, size_t height, size_t pbo_count, bool top_down);
+// Whether the returned rows start at the top of the image. Can be false even
+// if top_down was requested when the driver has no framebuffer blit.
+bool readback_is_top_down(Readback *readback);
+// Queues a readback of the framebuffer and sets *pixels to the RGBA8 pixels
+// of the oldest finished frame, or to NULL while the ring is still filling up.
+// The memory stays valid until the next readback_* call. Returns false when
+// the finished frame could not be mapped, which loses it.
+bool readback_frame(Readback *readback, unsigned int framebuffer, void **pixels);
+// Sets *pixels to the next frame still in flight, or to NULL when everything
+// is drained. Returns false when that frame could not be mapped.
+bool readback_flush(Readback *readback, void **pixels);
+void readback_end(Readback *readback);
+
+#endif // READBACK_H_
@@ -0,0 +1,158 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "render_stats.h"
+
+// Seconds between the progress lines printed while rendering
+#define RENDER_STATS_LOG_INTERVAL 2.0
+
+struct Render_Stats {
+    size_t total_frames;
+    size_t fps;
+    size_t frames;
+    double start_time;
+    double last_log_time;
+    double stages[COUNT_RENDER_STAGES];
+    FFMPEG_Stats encoder;
+};
+
+static const char *render_stage_names[COUNT_RENDER_STAGES] = {
+    [RENDER_STAGE_UPDATE] = "update",
+    [RENDER_STAGE_READBACK] = "readback",
+    [RENDER_STAGE_SEND] = "send",
+    [RENDER_STAGE_FLUSH] = "flush",
+};
+
+Render_Stats *render_stats_start(size_t total_frames, size_t fps) {
+    Render_Stats *stats = calloc(1, sizeof(Render_Stats));
+    assert(stats != NULL && "Buy MORE RAM lol!!");
+    stats->total_frames = total_frames;
+    stats->fps = fps;
+    stats->start_time = GetTime();
+    stats->last_log_time = stats->start_time;
+    return stats;
+}
+
+void render_stats_add(Render_Stats *stats, Render_Stage stage, double seconds) {
+    stats->stages[stage] += seconds;
+}
+
+static double render_stats_elapsed(Render_Stats *stats) {
+    return GetTime() - stats->start_time;
+}
+
+static double render_stats_fps(Render_Stats *stats) {
+    double elapsed = render_stats_elapsed(stats);
+    return elapsed > 0 ? stats->frames / elapsed : 0;
+}
+
+// Average milliseconds per rendered frame
+static double render_stats_ms(Render_Stats *stats, double seconds) {
+    return stats->frames > 0 ? seconds * 1000 / stats->frames : 0;
+}
+
+// Seconds until total_frames are rendered at the current rate, negative if unknown
+static double render_stats_eta(Render_Stats *stats) {
+    double fps = render_stats_fps(stats);
+    if (stats->total_frames == 0 || fps <= 0) return -1;
+    size_t left = stats->total_frames > stats->frames ? stats->total_frames - stats->frames : 0;
+    return left / fps;
+}
+
+static void render_stats_progress(Render_Stats *stats, char *buffer, size_t buffer_size) {
+    double eta = render_stats_eta(stats);
+    int n = 0;
+    if (stats->total_frames > 0) {
+        n = snprintf(buffer, buffer_size, "frame %zu/%zu (%.1f%%), %.1f fps (%.2fx real time)",
+                     stats->frames, stats->total_frames, 100.0 * stats->frames / stats->total_frames,
+                     render_stats_fps(stats), render_stats_fps(stats) / stats->fps);
+    } else {
+        n = snprintf(buffer, buffer_size, "frame %zu, %.1f fps (%.2fx real time)",
+                     stats->frames, render_stats_fps(stats), render_stats_fps(stats) / stats->fps);
+    }
+    if (eta > 0 && n >= 0 && (size_t)n < buffer_size) {
+        snprintf(buffer + n, buffer_size - n, ", ETA %dm%02ds", (int)eta / 60, (int)eta % 60);
+    }
+}
+
+static void render_stats_timings(Render_Stats *stats, char *buffer, size_t buffer_size) {
+    snprintf(buffer, buffer_size, "update %.2fms, readback %.2fms, send %.2fms (convert %.2fms, wait %.2fms), write %.2fms, backlog %zu",
+             render_stats_ms(stats, stats->stages[RENDER_STAGE_UPDATE]),
+             render_stats_ms(stats, stats->stages[RENDER_STAGE_READBACK]),
+             render_stats_ms(stats, stats->stages[RENDER_STAGE_SEND]),
+             render_stats_ms(stats, stats->encoder.convert_time),
+             render_stats_ms(stats, stats->encoder.wait_time),
+             render_stats_ms(stats, stats->encoder.write_time),
+             stats->encoder.queued);
+}
+
+void render_stats_sample(Render_Stats *stats, FFMPEG *ffmpeg) {
+    ffmpeg_get_stats(ffmpeg, &stats->encoder);
+}
+
+void render_stats_frame(Render_Stats *stats, FFMPEG *ffmpeg) {
+    stats->frames += 1;
+    render_stats_sample(stats, ffmpeg);
+
+    double now = GetTime();
+    if (now - stats->last_log_time >= RENDER_STATS_LOG_INTERVAL) {
+        stats->last_log_time = now;
+        // Goes around TraceLog(), rendering raises its level to LOG_WARNING
+        char progress[256], timings[256];
+        render_stats_progress(stats, progress, sizeof(progress));
+        render_stats_timings(stats, timings, sizeof(timings));
+        fprintf(stderr, "RENDER: %s\nRENDER: %s\n", progress, timings);
+    }
+}
+
+void render_stats_draw(Render_Stats *stats, Font font, Vector2 position, float font_size, Color color) {
+    char progress[256], timings[256];
+    render_stats_progress(stats, progress, sizeof(progress));
+    render_stats_timings(stats, timings, sizeof(timings));
+    DrawTextEx(font, progress, position, font_size, 0, color);
+    position.y += font_size;
+    DrawTextEx(font, timings, position, font_size, 0, color);
+}
+
+static bool render_stats_write_summary(Render_Stats *stats, bool ok, const char *summary_path) {
+    FILE *f = fopen(summary_path, "w");
+    if (f == NULL) {
+        TraceLog(LOG_ERROR, "RENDER: could not create %s: %s", summary_path, strerror(errno));
+        return false;
+    }
+    fprintf(f, "{\n");
+    fprintf(f, "    \"ok\": %s,\n", ok ? "true" : "false");
+    fprintf(f, "    \"frames\": %zu,\n", stats->frames);
+    fprintf(f, "    \"frames_sent\": %zu,\n", stats->encoder.frames_sent);
+    fprintf(f, "    \"elapsed\": %f,\n", render_stats_elapsed(stats));
+    fprintf(f, "    \"fps\": %f,\n", render_stats_fps(stats));
+    fprintf(f, "    \"stages\": {\n");
+    for (size_t i = 0; i < COUNT_RENDER_STAGES; ++i) {
+        fprintf(f, "        \"%s\": %f,\n", render_stage_names[i], stats->stages[i]);
+    }
+    fprintf(f, "        \"convert\": %f,\n", stats->encoder.convert_time);
+    fprintf(f, "        \"wait\": %f,\n", stats->encoder.wait_time);
+    fprintf(f, "        \"write\": %f\n", stats->encoder.write_time);
+    fprintf(f, "    }\n");
+    fprintf(f, "}\n");
+    if (fclose(f) != 0) {
+        TraceLog(LOG_ERROR, "RENDER: could not write %s: %s", summary_path, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+bool render_stats_end(Render_Stats *stats, bool ok, const char *summary_path) {
+    char progress[256], timings[256];
+    render_stats_progress(stats, progress, sizeof(progress));
+    render_stats_timings(stats, timings, sizeof(timings));
+    TraceLog(LOG_INFO, "RENDER: %s in %.2fs, flush %.2fs", progress, render_stats_elapsed(stats), stats->stages[RENDER_STAGE_FLUSH]);
+    TraceLog(LOG_INFO, "RENDER: %s", timings);
+
+    bool written = summary_path == NULL || render_stats_write_summary(stats, ok, summary_path);
+    free(stats);
+    return written;
+}
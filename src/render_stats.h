@@ -0,0 +1,33 @@
+#ifndef RENDER_STATS_H_
+#define RENDER_STATS_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include <raylib.h>
+#include "ffmpeg.h"
+
+// Per-stage timings of a video rendering session, shown in the rendering
+// overlay, logged periodically and optionally dumped as JSON at the end.
+typedef struct Render_Stats Render_Stats;
+
+typedef enum {
+    RENDER_STAGE_UPDATE,    // plug_update() into the render texture
+    RENDER_STAGE_READBACK,  // GPU -> CPU copy, includes waiting for the GPU to finish the frame
+    RENDER_STAGE_SEND,      // ffmpeg_send_frame*(), see FFMPEG_Stats for the breakdown
+    RENDER_STAGE_FLUSH,     // Draining the readback ring and the encoder at the end
+    COUNT_RENDER_STAGES,
+} Render_Stage;
+
+// total_frames of 0 means the length is unknown and no ETA is shown
+Render_Stats *render_stats_start(size_t total_frames, size_t fps);
+void render_stats_add(Render_Stats *stats, Render_Stage stage, double seconds);
+// Counts a rendered frame and samples the encoder counters of ffmpeg
+void render_stats_frame(Render_Stats *stats, FFMPEG *ffmpeg);
+// Samples the encoder counters once more, call it right before ffmpeg_end_rendering()
+void render_stats_sample(Render_Stats *stats, FFMPEG *ffmpeg);
+void render_stats_draw(Render_Stats *stats, Font font, Vector2 position, float font_size, Color color);
+// Logs the summary, writes it as JSON into summary_path unless it is NULL and frees stats
+bool render_stats_end(Render_Stats *stats, bool ok, const char *summary_path);
+
+#endif // RENDER_STATS_H_
@@ -1,19 +1,37 @@
 // NOTE(Realsanjeev): Rendering into FFMPEG doesnot work in main for this
 // The parameter that controls the smoothlife animation are:
 //  - DELTA_TIME
+//  - STEPS_PER_SECOND
 //  - TEXTURE_WIDTH
 //  - TEXTURE_HEIGHT
+// and at runtime through the environment:
+//  - SMOOTHLIFE_BACKEND=<backend>    How the simulation is stepped:
+//      shader     smoothlife.fs, sums every texel of the disk (default)
+//      spans      smoothlife_spans.fs, one span of the row prefix sums per row of the disk
+//      fft        FFT convolutions on the CPU
+//      cpu        the same disk sums as smoothlife.fs on the CPU
+//      cpu-spans  the same spans as smoothlife_spans.fs on the CPU
+//  - SMOOTHLIFE_RADIUS=<ra>          Outer radius of the neighbourhood (default: 21)
+//  - SMOOTHLIFE_STEPS_PER_SECOND=<n> Simulation steps per second (default: STEPS_PER_SECOND)
+//  - SMOOTHLIFE_SIZE=<w>x<h>         Grid size (default: TEXTURE_WIDTH x TEXTURE_HEIGHT)
+//  - SMOOTHLIFE_STATE=half|float     Format of the single channel state textures (default: half)
 #include <stdlib.h>
 #include <assert.h>
 #include <string.h>
 #include <stdint.h>
-#include <float.h>
+
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
 
 #include "raylib.h"
 #include "raymath.h"
+#include "rlgl.h"
 
 #include "nob.h"
 #include "ffmpeg.h"
+#include "trace.h"
+#include "smoothlife_cpu.h"
 
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
 
@@ -24,6 +42,12 @@
 #define TEXTURE_WIDTH (RENDER_WIDTH / 2)
 #define TEXTURE_HEIGHT (RENDER_HEIGHT / 2)
 #define DELTA_TIME (0.5f)
+// Simulation steps per second of animation time, SMOOTHLIFE_STEPS_PER_SECOND overrides it
+#define STEPS_PER_SECOND (60.0)
+// Interactively a frame steps for at most this many seconds of measured
+// (finished) work, or CATCH_UP_BUDGET while steps from earlier frames are due
+#define STEP_BUDGET (1.0 / 120.0)
+#define CATCH_UP_BUDGET (1.0 / 10.0)
 
 typedef struct {
     Font font;
@@ -34,6 +58,7 @@ typedef struct {
     int timeLoc;
     int resolutionLoc;
     int originLoc;
+    int tileOffsetLoc;
 } Info;
 
 typedef struct {
@@ -41,8 +66,31 @@ typedef struct {
     int timeLoc;
     int resolutionLoc;
     int texture0Loc;
+    int raLoc;
 } SmoothLife;
 
+// Row prefix sums of the state followed by one span per row of the disk
+typedef struct {
+    Shader prefix;
+    int strideLoc;
+    int firstLoc;
+    Shader step;
+    int timeLoc;
+    int resolutionLoc;
+    int prefixLoc;
+    int raLoc;
+    // Ping-pong targets of the prefix passes, single channel float
+    RenderTexture2D sums[2];
+} Spans;
+
+typedef enum {
+    BACKEND_SHADER,
+    BACKEND_SPANS,
+    BACKEND_FFT,
+    BACKEND_CPU,
+    BACKEND_CPU_SPANS,
+} Backend;
+
 typedef struct {
     RenderTexture2D state[2];
 
@@ -52,9 +100,27 @@ typedef struct {
 
     SmoothLife sl;
     Info info;
+
+    // Only set when simulating on the CPU, the state textures just display the grid then
+    SmoothLife_Cpu *cpu;
+
+    Backend backend;
+    Spans spans;
+
+    // Fixed time step scheduling, see simulation_update()
+    double stepsPerSecond;
+    double stepAccumulator;
+
+    // Grid size, the state textures have the same size unless a CPU grid
+    // exceeds the maximum texture size and only every displayScale-th cell is shown
+    int gridWidth;
+    int gridHeight;
+    int displayScale;
+    float *preview;
 } Plug;
 
 static Plug *p = NULL;
+static Vector2 tile_offset = {0};
 
 static float rand_float(void) {
     return (float)rand() / (float)RAND_MAX;
@@ -68,6 +134,126 @@ static void generateNoiseImage(Image *image) {
     }
 }
 
+static Backend backend_from_env(void) {
+    const char *backend = getenv("SMOOTHLIFE_BACKEND");
+    if (backend == NULL || strcmp(backend, "shader") == 0) return BACKEND_SHADER;
+    if (strcmp(backend, "spans") == 0) return BACKEND_SPANS;
+    if (strcmp(backend, "fft") == 0) return BACKEND_FFT;
+    if (strcmp(backend, "cpu") == 0) return BACKEND_CPU;
+    if (strcmp(backend, "cpu-spans") == 0) return BACKEND_CPU_SPANS;
+    TraceLog(LOG_WARNING, "Unknown SMOOTHLIFE_BACKEND %s, expected shader, spans, fft, cpu or cpu-spans", backend);
+    return BACKEND_SHADER;
+}
+
+// format is PIXELFORMAT_UNCOMPRESSED_R32 or PIXELFORMAT_UNCOMPRESSED_R16 (half float)
+static RenderTexture2D load_float_render_texture(int width, int height, PixelFormat format) {
+    RenderTexture2D target = {0};
+    target.id = rlLoadFramebuffer();
+    target.texture.id = rlLoadTexture(NULL, width, height, format, 1);
+    target.texture.width = width;
+    target.texture.height = height;
+    target.texture.mipmaps = 1;
+    target.texture.format = format;
+    rlFramebufferAttach(target.id, target.texture.id, RL_ATTACHMENT_COLOR_CHANNEL0, RL_ATTACHMENT_TEXTURE2D, 0);
+    if (!rlFramebufferComplete(target.id)) TraceLog(LOG_ERROR, "Float render targets are not supported");
+    return target;
+}
+
+static RenderTexture2D load_state_texture(int width, int height, PixelFormat format) {
+    RenderTexture2D target = load_float_render_texture(width, height, format);
+    SetTextureWrap(target.texture, TEXTURE_WRAP_REPEAT);
+    SetTextureFilter(target.texture, TEXTURE_FILTER_POINT);
+    // A single channel, but sampled and displayed as gray like an RGBA8 state
+    GLint swizzle[4] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+    glBindTexture(GL_TEXTURE_2D, target.texture.id);
+    glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return target;
+}
+
+static void load_grid_size(bool on_cpu) {
+    p->gridWidth = TEXTURE_WIDTH;
+    p->gridHeight = TEXTURE_HEIGHT;
+    const char *size = getenv("SMOOTHLIFE_SIZE");
+    if (size != NULL) {
+        int width = 0, height = 0;
+        if (sscanf(size, "%dx%d", &width, &height) == 2 && width > 0 && height > 0) {
+            p->gridWidth = width;
+            p->gridHeight = height;
+        } else {
+            TraceLog(LOG_WARNING, "Invalid SMOOTHLIFE_SIZE %s, expected <width>x<height>", size);
+        }
+    }
+
+    GLint max_texture_size = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_texture_size);
+    if (max_texture_size <= 0) max_texture_size = p->gridWidth > p->gridHeight ? p->gridWidth : p->gridHeight;
+    p->displayScale = 1;
+    if (!on_cpu) {
+        // The state lives in textures on the GPU
+        if (p->gridWidth > max_texture_size || p->gridHeight > max_texture_size) {
+            TraceLog(LOG_WARNING, "SmoothLife grid %dx%d exceeds the maximum texture size %d, use a CPU backend for it",
+                     p->gridWidth, p->gridHeight, max_texture_size);
+            p->gridWidth = MIN(p->gridWidth, max_texture_size);
+            p->gridHeight = MIN(p->gridHeight, max_texture_size);
+        }
+    } else {
+        while ((p->gridWidth + p->displayScale - 1) / p->displayScale > max_texture_size ||
+               (p->gridHeight + p->displayScale - 1) / p->displayScale > max_texture_size) {
+            p->displayScale += 1;
+        }
+    }
+}
+
+static PixelFormat state_format_from_env(void) {
+    const char *state = getenv("SMOOTHLIFE_STATE");
+    if (state == NULL || strcmp(state, "half") == 0) return PIXELFORMAT_UNCOMPRESSED_R16;
+    if (strcmp(state, "float") == 0) return PIXELFORMAT_UNCOMPRESSED_R32;
+    TraceLog(LOG_WARNING, "Unknown SMOOTHLIFE_STATE %s, expected half or float", state);
+    return PIXELFORMAT_UNCOMPRESSED_R16;
+}
+
+// Uploads the CPU grid into the current state texture for display
+static void present_grid(void) {
+    const float *grid = smoothlife_cpu_grid(p->cpu);
+    if (p->displayScale == 1) {
+        UpdateTexture(p->state[p->currentState].texture, grid);
+        return;
+    }
+    int width = p->state[p->currentState].texture.width;
+    int height = p->state[p->currentState].texture.height;
+    for (int y = 0; y < height; ++y) {
+        const float *row = grid + (size_t)y * p->displayScale * p->gridWidth;
+        for (int x = 0; x < width; ++x) p->preview[(size_t)y * width + x] = row[(size_t)x * p->displayScale];
+    }
+    UpdateTexture(p->state[p->currentState].texture, p->preview);
+}
+
+static void load_spans(float ra) {
+    p->spans.prefix = LoadShader(NULL, "./assets/shaders/smoothlife_prefix.fs");
+    if (!p->spans.prefix.id) TraceLog(LOG_ERROR, "Failed to load smoothlife prefix shader.");
+    p->spans.strideLoc = GetShaderLocation(p->spans.prefix, "u_stride");
+    p->spans.firstLoc = GetShaderLocation(p->spans.prefix, "u_first");
+
+    p->spans.step = LoadShader(NULL, "./assets/shaders/smoothlife_spans.fs");
+    if (!p->spans.step.id) TraceLog(LOG_ERROR, "Failed to load smoothlife spans shader.");
+    p->spans.resolutionLoc = GetShaderLocation(p->spans.step, "resolution");
+    p->spans.timeLoc = GetShaderLocation(p->spans.step, "dt");
+    p->spans.prefixLoc = GetShaderLocation(p->spans.step, "u_prefix");
+    p->spans.raLoc = GetShaderLocation(p->spans.step, "ra");
+    SetShaderValue(p->spans.step, p->spans.raLoc, &ra, SHADER_UNIFORM_FLOAT);
+
+    p->spans.sums[0] = load_float_render_texture(p->gridWidth, p->gridHeight, PIXELFORMAT_UNCOMPRESSED_R32);
+    p->spans.sums[1] = load_float_render_texture(p->gridWidth, p->gridHeight, PIXELFORMAT_UNCOMPRESSED_R32);
+}
+
+static void unload_spans(void) {
+    UnloadShader(p->spans.prefix);
+    UnloadShader(p->spans.step);
+    UnloadRenderTexture(p->spans.sums[0]);
+    UnloadRenderTexture(p->spans.sums[1]);
+}
+
 static void load_resources(void) {
     assert(p);
 
@@ -76,6 +262,30 @@ static void load_resources(void) {
     p->sl.resolutionLoc = GetShaderLocation(p->sl.shader, "resolution");
     p->sl.timeLoc = GetShaderLocation(p->sl.shader, "dt");
     p->sl.texture0Loc = GetShaderLocation(p->sl.shader, "texture0");
+    p->sl.raLoc = GetShaderLocation(p->sl.shader, "ra");
+
+    SmoothLife_Rules rules = SMOOTHLIFE_RULES_DEFAULT;
+    const char *radius = getenv("SMOOTHLIFE_RADIUS");
+    if (radius != NULL) {
+        float ra = strtof(radius, NULL);
+        if (ra >= 1.0f) {
+            rules.ra = ra;
+        } else {
+            TraceLog(LOG_WARNING, "Invalid SMOOTHLIFE_RADIUS %s, using %g", radius, rules.ra);
+        }
+    }
+    SetShaderValue(p->sl.shader, p->sl.raLoc, &rules.ra, SHADER_UNIFORM_FLOAT);
+
+    p->stepsPerSecond = STEPS_PER_SECOND;
+    const char *steps_per_second = getenv("SMOOTHLIFE_STEPS_PER_SECOND");
+    if (steps_per_second != NULL) {
+        double value = strtod(steps_per_second, NULL);
+        if (value > 0.0) {
+            p->stepsPerSecond = value;
+        } else {
+            TraceLog(LOG_WARNING, "Invalid SMOOTHLIFE_STEPS_PER_SECOND %s, using %g", steps_per_second, p->stepsPerSecond);
+        }
+    }
 
     p->info.font = LoadFontEx("./assets/fonts/iosevka-regular.ttf", FONT_SIZE, NULL, 0);
     p->info.shader = LoadShader(NULL, "./assets/shaders/info.fs");
@@ -83,26 +293,62 @@ static void load_resources(void) {
     p->info.timeLoc = GetShaderLocation(p->info.shader, "u_time");
     p->info.resolutionLoc = GetShaderLocation(p->info.shader, "u_resolution");
     p->info.originLoc = GetShaderLocation(p->info.shader, "u_origin");
+    p->info.tileOffsetLoc = GetShaderLocation(p->info.shader, "u_tile_offset");
     p->info.text = "Made by realsanjeev";
 
     if (p->info.originLoc == -1) {
         TraceLog(LOG_WARNING, "SHADER: [info.fs] Uniform 'u_origin' not found");
     }
 
-    Image image = GenImagePerlinNoise(TEXTURE_WIDTH, TEXTURE_HEIGHT, 0, 0, 2.0f);
-    // Image image = GenImageWhiteNoise(TEXTURE_WIDTH, TEXTURE_HEIGHT, 2.0f);
-    // Image image = GenImageColor(TEXTURE_WIDTH, TEXTURE_HEIGHT, WHITE);
-    // generateNoiseImage(&image);
+    p->cpu = NULL;
+    p->preview = NULL;
+    p->backend = backend_from_env();
+    SmoothLife_Kernel kernel = SMOOTHLIFE_KERNEL_DIRECT;
+    const char *kernel_name = NULL;
+    switch (p->backend) {
+    case BACKEND_SHADER:
+    case BACKEND_SPANS:
+        break;
+    case BACKEND_FFT:       kernel = SMOOTHLIFE_KERNEL_FFT;    kernel_name = "FFT convolutions"; break;
+    case BACKEND_CPU:       kernel = SMOOTHLIFE_KERNEL_DIRECT; kernel_name = "direct disk sums"; break;
+    case BACKEND_CPU_SPANS: kernel = SMOOTHLIFE_KERNEL_SPANS;  kernel_name = "prefix sum spans"; break;
+    }
+    bool on_cpu = kernel_name != NULL;
 
-    p->state[0] = LoadRenderTexture(TEXTURE_WIDTH, TEXTURE_HEIGHT);
-    SetTextureWrap(p->state[0].texture, TEXTURE_WRAP_REPEAT);
-    SetTextureFilter(p->state[0].texture, TEXTURE_FILTER_POINT);
-    UpdateTexture(p->state[0].texture, image.data);
+    load_grid_size(on_cpu);
+    if (p->backend == BACKEND_SPANS) load_spans(rules.ra);
 
-    p->state[1] = LoadRenderTexture(TEXTURE_WIDTH, TEXTURE_HEIGHT);
-    SetTextureWrap(p->state[1].texture, TEXTURE_WRAP_REPEAT);
-    SetTextureFilter(p->state[1].texture, TEXTURE_FILTER_POINT);
+    Image image = GenImagePerlinNoise(p->gridWidth, p->gridHeight, 0, 0, 2.0f);
+    // Image image = GenImageWhiteNoise(p->gridWidth, p->gridHeight, 2.0f);
+    // Image image = GenImageColor(p->gridWidth, p->gridHeight, WHITE);
+    // generateNoiseImage(&image);
 
+    if (on_cpu) {
+        // The grid is float on the CPU, the textures only display it
+        p->cpu = smoothlife_cpu_start(p->gridWidth, p->gridHeight, rules, kernel, 0);
+        ImageFormat(&image, PIXELFORMAT_UNCOMPRESSED_R32);
+        memcpy(smoothlife_cpu_grid(p->cpu), image.data, (size_t)p->gridWidth * p->gridHeight * sizeof(float));
+
+        int width = (p->gridWidth + p->displayScale - 1) / p->displayScale;
+        int height = (p->gridHeight + p->displayScale - 1) / p->displayScale;
+        p->state[0] = load_state_texture(width, height, PIXELFORMAT_UNCOMPRESSED_R32);
+        p->state[1] = load_state_texture(width, height, PIXELFORMAT_UNCOMPRESSED_R32);
+        if (p->displayScale > 1) {
+            p->preview = malloc((size_t)width * height * sizeof(*p->preview));
+            assert(p->preview != NULL && "Buy MORE RAM lol!!");
+            TraceLog(LOG_INFO, "SmoothLife grid exceeds the maximum texture size, showing every %d-th cell", p->displayScale);
+        }
+        present_grid();
+        TraceLog(LOG_INFO, "SmoothLife runs on the CPU with %s, %dx%d, ra = %g", kernel_name, p->gridWidth, p->gridHeight, rules.ra);
+    } else {
+        PixelFormat format = state_format_from_env();
+        ImageFormat(&image, format);
+        p->state[0] = load_state_texture(p->gridWidth, p->gridHeight, format);
+        p->state[1] = load_state_texture(p->gridWidth, p->gridHeight, format);
+        UpdateTexture(p->state[0].texture, image.data);
+        TraceLog(LOG_INFO, "SmoothLife runs on the GPU, %dx%d %s float state, ra = %g", p->gridWidth, p->gridHeight,
+                 format == PIXELFORMAT_UNCOMPRESSED_R16 ? "half" : "full", rules.ra);
+    }
     UnloadImage(image);
 }
 
@@ -113,12 +359,23 @@ static void unload_resources(void) {
     UnloadShader(p->info.shader);
     UnloadRenderTexture(p->state[0]);
     UnloadRenderTexture(p->state[1]);
+    if (p->backend == BACKEND_SPANS) unload_spans();
+    if (p->cpu != NULL) smoothlife_cpu_end(p->cpu);
+    free(p->preview);
+    p->cpu = NULL;
+    p->preview = NULL;
 }
 
 void plug_reset(void) {
     if (!p) return;
     p->time = 0.0f;
     p->currentState = 0;
+    p->stepAccumulator = 0.0;
+}
+
+// Offset of gl_FragCoord when main renders the frame in tiles, see tiled.h
+void plug_set_tile(float x, float y) {
+    tile_offset = (Vector2){x, y};
 }
 
 void plug_init(void) {
@@ -189,32 +446,156 @@ void DrawWrappedText(const Font font, const char *text, Rectangle bounds, float
     }
 }
 
-void plug_update(float dt, float w, float h) {
-    // ClearBackground(BACKGROUND_COLOR);
-    float smoothLifedt = (dt <= FLT_EPSILON) ? 0.0f : DELTA_TIME;
-    p->time += dt;
+// One simulation step of dt into p->state[p->currentState] (GPU) or the grid (CPU)
+static void simulation_step(float dt) {
+    float slResolution[2] = { (float)p->gridWidth, (float)p->gridHeight };
 
-    float slResolution[2] = { (float)TEXTURE_WIDTH, (float)TEXTURE_HEIGHT };
+    if (p->cpu != NULL) {
+        smoothlife_cpu_step(p->cpu, dt);
+        return;
+    }
 
-    // Run simulation shader
-    BeginTextureMode(p->state[1 - p->currentState]);
-        BeginShaderMode(p->sl.shader);
-            // Set shader inputs
-            SetShaderValueTexture(p->sl.shader, p->sl.texture0Loc, p->state[p->currentState].texture);
-            SetShaderValue(p->sl.shader, p->sl.resolutionLoc, slResolution, SHADER_UNIFORM_VEC2);
-            SetShaderValue(p->sl.shader, p->sl.timeLoc, &smoothLifedt, SHADER_UNIFORM_FLOAT);
-            DrawTexture(p->state[p->currentState].texture, 0, 0, WHITE);
-        EndShaderMode();
-    EndTextureMode();
+    if (p->backend == BACKEND_SPANS) {
+        // Inclusive prefix sums of the rows in log2(width) passes
+        Texture2D source = p->state[p->currentState].texture;
+        int stride = 1;
+        size_t pass = 0;
+        do {
+            int first = pass == 0;
+            BeginTextureMode(p->spans.sums[pass % 2]);
+                BeginShaderMode(p->spans.prefix);
+                    SetShaderValue(p->spans.prefix, p->spans.strideLoc, &stride, SHADER_UNIFORM_INT);
+                    SetShaderValue(p->spans.prefix, p->spans.firstLoc, &first, SHADER_UNIFORM_INT);
+                    DrawTexture(source, 0, 0, WHITE);
+                EndShaderMode();
+            EndTextureMode();
+            source = p->spans.sums[pass % 2].texture;
+            stride *= 2;
+            pass += 1;
+        } while (stride < p->gridWidth);
+
+        BeginTextureMode(p->state[1 - p->currentState]);
+            BeginShaderMode(p->spans.step);
+                SetShaderValueTexture(p->spans.step, p->spans.prefixLoc, source);
+                SetShaderValue(p->spans.step, p->spans.resolutionLoc, slResolution, SHADER_UNIFORM_VEC2);
+                SetShaderValue(p->spans.step, p->spans.timeLoc, &dt, SHADER_UNIFORM_FLOAT);
+                DrawTexture(p->state[p->currentState].texture, 0, 0, WHITE);
+            EndShaderMode();
+        EndTextureMode();
+    } else {
+        // Run simulation shader
+        BeginTextureMode(p->state[1 - p->currentState]);
+            BeginShaderMode(p->sl.shader);
+                // Set shader inputs
+                SetShaderValueTexture(p->sl.shader, p->sl.texture0Loc, p->state[p->currentState].texture);
+                SetShaderValue(p->sl.shader, p->sl.resolutionLoc, slResolution, SHADER_UNIFORM_VEC2);
+                SetShaderValue(p->sl.shader, p->sl.timeLoc, &dt, SHADER_UNIFORM_FLOAT);
+                DrawTexture(p->state[p->currentState].texture, 0, 0, WHITE);
+            EndShaderMode();
+        EndTextureMode();
+    }
 
     // Swap states
     p->currentState = 1 - p->currentState;
+}
+
+// Waits until the steps submitted so far are done. On the GPU backends
+// GetTime() alone would only measure how long submitting them took.
+static void simulation_sync(void) {
+    if (p->cpu != NULL) return;
+    rlDrawRenderBatchActive();
+    glFinish();
+}
+
+// Runs the steps that are due after dt seconds at p->stepsPerSecond. Offline
+// renders run all of them to stay deterministic. Interactively a frame runs
+// as many as fit into STEP_BUDGET and carries the rest over, and while it is
+// behind it spends CATCH_UP_BUDGET on them, so presentation gets skipped in
+// favour of stepping until the simulation caught up. Simulated time is never
+// dropped. Returns the amount of steps taken.
+static size_t simulation_update(float dt, bool offline) {
+    // A paused animation freezes any backlog too
+    if (dt <= 0.0f) return 0;
+
+    // dt of 1/fps may round to just below a whole step
+    const double epsilon = 1e-6;
+    bool behind = p->stepAccumulator >= 1.0 - epsilon;
+    p->stepAccumulator += (double)dt * p->stepsPerSecond;
+    size_t due = (size_t)floor(p->stepAccumulator + epsilon);
+
+    size_t steps = 0;
+    if (offline) {
+        for (; steps < due; ++steps) simulation_step(DELTA_TIME);
+    } else {
+        // Steps are run in batches sized from the measured cost of the
+        // previous ones, with one sync per batch instead of one per step
+        double budget = behind ? CATCH_UP_BUDGET : STEP_BUDGET;
+        simulation_sync();
+        double start = GetTime();
+        size_t batch = 1;
+        while (steps < due) {
+            for (size_t i = 0; i < batch && steps < due; ++i, ++steps) simulation_step(DELTA_TIME);
+            simulation_sync();
+            double elapsed = GetTime() - start;
+            if (elapsed >= budget) break;
+            double per_step = elapsed / steps;
+            batch = per_step > 0.0 ? (size_t)((budget - elapsed) / per_step) : due - steps;
+            if (batch < 1) batch = 1;
+        }
+    }
+    p->stepAccumulator -= (double)steps;
+    if (p->stepAccumulator < 0.0) p->stepAccumulator = 0.0;
+    return steps;
+}
+
+// The render target plug_update() was called with. The steps render into the
+// state textures and EndTextureMode() leaves the default framebuffer bound,
+// so the caller's target (tile, offscreen frame, golden render) is put back
+// before drawing.
+typedef struct {
+    GLint framebuffer;
+    GLint viewport[4];
+    Matrix projection;
+    Matrix modelview;
+} Render_Target;
+
+static Render_Target save_render_target(void) {
+    Render_Target target = {0};
+    rlDrawRenderBatchActive();
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target.framebuffer);
+    glGetIntegerv(GL_VIEWPORT, target.viewport);
+    target.projection = rlGetMatrixProjection();
+    target.modelview = rlGetMatrixModelview();
+    return target;
+}
+
+static void restore_render_target(Render_Target target) {
+    rlDrawRenderBatchActive();
+    rlEnableFramebuffer((unsigned int)target.framebuffer);
+    rlViewport(target.viewport[0], target.viewport[1], target.viewport[2], target.viewport[3]);
+    rlSetMatrixProjection(target.projection);
+    rlSetMatrixModelview(target.modelview);
+}
+
+void plug_update(float dt, float w, float h, bool offline) {
+    // ClearBackground(BACKGROUND_COLOR);
+    p->time += dt;
+
+    trace_begin("smoothlife step");
+    Render_Target target = {0};
+    if (p->cpu == NULL) target = save_render_target();
+    size_t steps = simulation_update(dt, offline);
+    if (p->cpu == NULL) restore_render_target(target);
+    // The CPU grid is only uploaded for display once per frame, whatever the amount of steps
+    if (p->cpu != NULL && steps > 0) present_grid();
+    trace_end();
 
     // Draw to screen
     ClearBackground(BACKGROUND_COLOR);
-    float scale = MIN(w / TEXTURE_WIDTH, h / TEXTURE_HEIGHT);
-    Vector2 offset = { (w - TEXTURE_WIDTH * scale) / 2.0f, (h - TEXTURE_HEIGHT * scale) / 2.0f };
-    DrawTextureEx(p->state[1 - p->currentState].texture, offset, 0.0f, scale, WHITE);
+    Texture2D state = p->state[p->currentState].texture;
+    float scale = MIN(w / state.width, h / state.height);
+    Vector2 offset = { (w - state.width * scale) / 2.0f, (h - state.height * scale) / 2.0f };
+    DrawTextureEx(state, offset, 0.0f, scale, WHITE);
 
     // Overlay info text
     float padding = 10;
@@ -232,6 +613,7 @@ void plug_update(float dt, float w, float h) {
         SetShaderValue(p->info.shader, p->info.timeLoc, &p->time, SHADER_UNIFORM_FLOAT);
         SetShaderValue(p->info.shader, p->info.resolutionLoc, infoResolution, SHADER_UNIFORM_VEC2);
         SetShaderValue(p->info.shader, p->info.originLoc, origin, SHADER_UNIFORM_VEC2);
+        SetShaderValue(p->info.shader, p->info.tileOffsetLoc, &tile_offset, SHADER_UNIFORM_VEC2);
         DrawRectangleRec(textBounds, BLANK);
     EndShaderMode();
 
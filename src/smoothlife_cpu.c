@@ -0,0 +1,471 @@
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// The AVX2 path is picked at runtime, so it is built on every x86 target
+#if defined(__x86_64__) || defined(__i386__)
+#define SMOOTHLIFE_CPU_X86
+#include <immintrin.h>
+#endif
+
+#include "smoothlife_cpu.h"
+#include "fft.h"
+#include "thread_pool.h"
+#include "trace.h"
+
+#define PI_F 3.14159265359f
+
+struct SmoothLife_Cpu {
+    size_t width;
+    size_t height;
+    SmoothLife_Rules rules;
+    SmoothLife_Kernel kernel;
+    float *grid;
+
+    // SMOOTHLIFE_KERNEL_FFT
+    Fft *fft_rows;
+    Fft *fft_cols;
+    Fft_Complex *spectrum;
+    // Spectrum of inner disk + i * annulus, normalized by their areas and the FFT size
+    Fft_Complex *kernel_spectrum;
+    // Two lines of max(width, height) for every thread
+    Fft_Complex *scratch;
+    size_t scratch_stride;
+    float dt;
+
+    // SMOOTHLIFE_KERNEL_DIRECT
+    // The grid with `pad` wrapped cells on every side, so every neighbour is a plain offset
+    float *padded;
+    size_t pad;
+    size_t padded_width;
+    ptrdiff_t *inner_offsets;
+    size_t inner_count;
+    ptrdiff_t *outer_offsets;
+    size_t outer_count;
+    bool avx2;
+
+    // SMOOTHLIFE_KERNEL_SPANS, also uses padded
+    // Exclusive prefix sums of every padded row, padded_width + 1 each
+    float *prefix;
+    int *inner_extents;
+    int *outer_extents;
+
+    // Every job is split into one band per thread of the pool
+    Thread_Pool *pool;
+};
+
+static inline float smoothlife_sigma(float x, float a, float alpha) {
+    return 1.0f / (1.0f + expf(-(x - a) * 4.0f / alpha));
+}
+
+// The growth of a cell with inner filling m and outer filling n, in [-1, 1]
+static inline float smoothlife_growth(const SmoothLife_Rules *rules, float n, float m) {
+    float sm = smoothlife_sigma(m, 0.5f, rules->alpha_m);
+    float a = rules->b1 * (1.0f - sm) + rules->d1 * sm;
+    float b = rules->b2 * (1.0f - sm) + rules->d2 * sm;
+    float q = smoothlife_sigma(n, a, rules->alpha_n) * (1.0f - smoothlife_sigma(n, b, rules->alpha_n));
+    return 2.0f * q - 1.0f;
+}
+
+static inline float smoothlife_clamp(float x) {
+    return x < 0.0f ? 0.0f : x > 1.0f ? 1.0f : x;
+}
+
+static inline Fft_Complex smoothlife_conj(Fft_Complex a) {
+    return (Fft_Complex){ a.re, -a.im };
+}
+
+// Forward FFT of two real rows at once, packed into the real and imaginary part
+static void smoothlife_fft_rows_forward(void *user, size_t begin, size_t end, size_t thread) {
+    SmoothLife_Cpu *cpu = user;
+    size_t width = cpu->width;
+    Fft_Complex *in = cpu->scratch + thread * cpu->scratch_stride;
+    Fft_Complex *out = in + cpu->scratch_stride / 2;
+
+    for (size_t pair = begin; pair < end; ++pair) {
+        size_t a = 2*pair;
+        size_t b = a + 1;
+        const float *row_a = cpu->grid + a * width;
+        const float *row_b = b < cpu->height ? cpu->grid + b * width : NULL;
+        for (size_t x = 0; x < width; ++x) {
+            in[x] = (Fft_Complex){ row_a[x], row_b != NULL ? row_b[x] : 0.0f };
+        }
+        fft_forward(cpu->fft_rows, in, out);
+
+        // X_a = (Z[k] + conj(Z[-k])) / 2, X_b = (Z[k] - conj(Z[-k])) / 2i
+        for (size_t k = 0; k < width; ++k) {
+            Fft_Complex z = out[k];
+            Fft_Complex mirror = smoothlife_conj(out[k == 0 ? 0 : width - k]);
+            cpu->spectrum[a * width + k] = (Fft_Complex){ 0.5f * (z.re + mirror.re), 0.5f * (z.im + mirror.im) };
+            if (row_b != NULL) {
+                cpu->spectrum[b * width + k] = (Fft_Complex){ 0.5f * (z.im - mirror.im), -0.5f * (z.re - mirror.re) };
+            }
+        }
+    }
+}
+
+// Column FFT, multiplication with the kernels and the column pass of the inverse
+// FFT in one go. The inverse is a forward FFT of the conjugate.
+static void smoothlife_fft_columns(void *user, size_t begin, size_t end, size_t thread) {
+    SmoothLife_Cpu *cpu = user;
+    size_t width = cpu->width;
+    size_t height = cpu->height;
+    Fft_Complex *in = cpu->scratch + thread * cpu->scratch_stride;
+    Fft_Complex *out = in + cpu->scratch_stride / 2;
+
+    for (size_t x = begin; x < end; ++x) {
+        for (size_t y = 0; y < height; ++y) in[y] = cpu->spectrum[y * width + x];
+        fft_forward(cpu->fft_cols, in, out);
+        for (size_t y = 0; y < height; ++y) {
+            Fft_Complex f = out[y];
+            Fft_Complex k = cpu->kernel_spectrum[y * width + x];
+            in[y] = (Fft_Complex){ f.re*k.re - f.im*k.im, -(f.re*k.im + f.im*k.re) };
+        }
+        fft_forward(cpu->fft_cols, in, out);
+        for (size_t y = 0; y < height; ++y) cpu->spectrum[y * width + x] = out[y];
+    }
+}
+
+// Row pass of the inverse FFT, which yields m + i*n, followed by the transition
+static void smoothlife_fft_rows_step(void *user, size_t begin, size_t end, size_t thread) {
+    SmoothLife_Cpu *cpu = user;
+    size_t width = cpu->width;
+    Fft_Complex *out = cpu->scratch + thread * cpu->scratch_stride;
+
+    for (size_t y = begin; y < end; ++y) {
+        fft_forward(cpu->fft_rows, cpu->spectrum + y * width, out);
+        float *row = cpu->grid + y * width;
+        for (size_t x = 0; x < width; ++x) {
+            float m = out[x].re;
+            float n = -out[x].im;
+            row[x] = smoothlife_clamp(row[x] + cpu->dt * smoothlife_growth(&cpu->rules, n, m));
+        }
+    }
+}
+
+static void smoothlife_direct_pad(void *user, size_t begin, size_t end, size_t thread) {
+    SmoothLife_Cpu *cpu = user;
+    (void) thread;
+    size_t width = cpu->width;
+    size_t height = cpu->height;
+    size_t pad = cpu->pad;
+    for (size_t py = begin; py < end; ++py) {
+        const float *row = cpu->grid + ((py + height - pad % height) % height) * width;
+        float *dst = cpu->padded + py * cpu->padded_width;
+        for (size_t px = 0; px < cpu->padded_width; ++px) {
+            dst[px] = row[(px + width - pad % width) % width];
+        }
+    }
+}
+
+// sums[x] = sum of center[x + offset] over all offsets, for x in [0, width)
+static void smoothlife_direct_sums_scalar(const float *center, const ptrdiff_t *offsets, size_t count, size_t begin, size_t width, float *sums) {
+    for (size_t x = begin; x < width; ++x) {
+        float sum = 0.0f;
+        for (size_t i = 0; i < count; ++i) sum += center[x + offsets[i]];
+        sums[x] = sum;
+    }
+}
+
+#if defined(SMOOTHLIFE_CPU_X86)
+__attribute__((target("avx2")))
+static void smoothlife_direct_sums_avx2(const float *center, const ptrdiff_t *offsets, size_t count, size_t width, float *sums) {
+    size_t x = 0;
+    // 32 columns in four independent accumulators
+    for (; x + 32 <= width; x += 32) {
+        __m256 sum0 = _mm256_setzero_ps();
+        __m256 sum1 = _mm256_setzero_ps();
+        __m256 sum2 = _mm256_setzero_ps();
+        __m256 sum3 = _mm256_setzero_ps();
+        for (size_t i = 0; i < count; ++i) {
+            const float *src = center + x + offsets[i];
+            sum0 = _mm256_add_ps(sum0, _mm256_loadu_ps(src));
+            sum1 = _mm256_add_ps(sum1, _mm256_loadu_ps(src + 8));
+            sum2 = _mm256_add_ps(sum2, _mm256_loadu_ps(src + 16));
+            sum3 = _mm256_add_ps(sum3, _mm256_loadu_ps(src + 24));
+        }
+        _mm256_storeu_ps(sums + x, sum0);
+        _mm256_storeu_ps(sums + x + 8, sum1);
+        _mm256_storeu_ps(sums + x + 16, sum2);
+        _mm256_storeu_ps(sums + x + 24, sum3);
+    }
+    for (; x + 8 <= width; x += 8) {
+        __m256 sum = _mm256_setzero_ps();
+        for (size_t i = 0; i < count; ++i) sum = _mm256_add_ps(sum, _mm256_loadu_ps(center + x + offsets[i]));
+        _mm256_storeu_ps(sums + x, sum);
+    }
+    smoothlife_direct_sums_scalar(center, offsets, count, x, width, sums);
+}
+#endif
+
+static void smoothlife_direct_rows(void *user, size_t begin, size_t end, size_t thread) {
+    SmoothLife_Cpu *cpu = user;
+    size_t width = cpu->width;
+    float ri = cpu->rules.ra / 3.0f;
+    float inner_area = PI_F * ri * ri;
+    float outer_area = PI_F * cpu->rules.ra * cpu->rules.ra - inner_area;
+    float *m = (float *)(cpu->scratch + thread * cpu->scratch_stride);
+    float *n = m + width;
+
+    for (size_t y = begin; y < end; ++y) {
+        const float *center = cpu->padded + (y + cpu->pad) * cpu->padded_width + cpu->pad;
+#if defined(SMOOTHLIFE_CPU_X86)
+        if (cpu->avx2) {
+            smoothlife_direct_sums_avx2(center, cpu->inner_offsets, cpu->inner_count, width, m);
+            smoothlife_direct_sums_avx2(center, cpu->outer_offsets, cpu->outer_count, width, n);
+        } else
+#endif
+        {
+            smoothlife_direct_sums_scalar(center, cpu->inner_offsets, cpu->inner_count, 0, width, m);
+            smoothlife_direct_sums_scalar(center, cpu->outer_offsets, cpu->outer_count, 0, width, n);
+        }
+
+        float *row = cpu->grid + y * width;
+        for (size_t x = 0; x < width; ++x) {
+            float growth = smoothlife_growth(&cpu->rules, n[x] / outer_area, m[x] / inner_area);
+            row[x] = smoothlife_clamp(center[x] + cpu->dt * growth);
+        }
+    }
+}
+
+int smoothlife_span_extent(float radius_sq, int dy) {
+    float dy_sq = (float)(dy*dy);
+    if (dy_sq > radius_sq) return -1;
+    int extent = (int)sqrtf(radius_sq - dy_sq);
+    // sqrtf may round either way, settle on the exact float test
+    while ((float)((extent + 1)*(extent + 1)) + dy_sq <= radius_sq) extent += 1;
+    while (extent >= 0 && (float)(extent*extent) + dy_sq > radius_sq) extent -= 1;
+    return extent;
+}
+
+static void smoothlife_spans_pad(void *user, size_t begin, size_t end, size_t thread) {
+    SmoothLife_Cpu *cpu = user;
+    smoothlife_direct_pad(cpu, begin, end, thread);
+    size_t stride = cpu->padded_width + 1;
+    for (size_t py = begin; py < end; ++py) {
+        const float *row = cpu->padded + py * cpu->padded_width;
+        float *prefix = cpu->prefix + py * stride;
+        float sum = 0.0f;
+        prefix[0] = 0.0f;
+        for (size_t px = 0; px < cpu->padded_width; ++px) {
+            sum += row[px];
+            prefix[px + 1] = sum;
+        }
+    }
+}
+
+static void smoothlife_spans_rows(void *user, size_t begin, size_t end, size_t thread) {
+    SmoothLife_Cpu *cpu = user;
+    size_t width = cpu->width;
+    size_t stride = cpu->padded_width + 1;
+    int r = cpu->pad;
+    float ri = cpu->rules.ra / 3.0f;
+    float inner_area = PI_F * ri * ri;
+    float outer_area = PI_F * cpu->rules.ra * cpu->rules.ra - inner_area;
+    float *m = (float *)(cpu->scratch + thread * cpu->scratch_stride);
+    float *n = m + width;
+
+    for (size_t y = begin; y < end; ++y) {
+        memset(m, 0, width * sizeof(*m));
+        memset(n, 0, width * sizeof(*n));
+        for (int dy = -r; dy <= r; ++dy) {
+            // prefix[x + e + 1] - prefix[x - e] sums the cells x - e ... x + e
+            const float *prefix = cpu->prefix + (y + r + dy) * stride + r;
+            int inner = cpu->inner_extents[dy + r];
+            int outer = cpu->outer_extents[dy + r];
+            if (outer < 0) continue;
+            const float *outer_end = prefix + outer + 1;
+            const float *outer_begin = prefix - outer;
+            if (inner >= 0) {
+                const float *inner_end = prefix + inner + 1;
+                const float *inner_begin = prefix - inner;
+                for (size_t x = 0; x < width; ++x) {
+                    float inner_sum = inner_end[x] - inner_begin[x];
+                    m[x] += inner_sum;
+                    n[x] += outer_end[x] - outer_begin[x] - inner_sum;
+                }
+            } else {
+                for (size_t x = 0; x < width; ++x) n[x] += outer_end[x] - outer_begin[x];
+            }
+        }
+
+        const float *center = cpu->padded + (y + r) * cpu->padded_width + r;
+        float *row = cpu->grid + y * width;
+        for (size_t x = 0; x < width; ++x) {
+            float growth = smoothlife_growth(&cpu->rules, n[x] / outer_area, m[x] / inner_area);
+            row[x] = smoothlife_clamp(center[x] + cpu->dt * growth);
+        }
+    }
+}
+
+static void smoothlife_spans_start(SmoothLife_Cpu *cpu) {
+    float ra = cpu->rules.ra;
+    float ri = ra / 3.0f;
+    int r = (int)floorf(ra);
+    cpu->pad = r;
+    cpu->padded_width = cpu->width + 2*r;
+    size_t padded_height = cpu->height + 2*r;
+    cpu->padded = malloc(cpu->padded_width * padded_height * sizeof(*cpu->padded));
+    cpu->prefix = malloc((cpu->padded_width + 1) * padded_height * sizeof(*cpu->prefix));
+    cpu->inner_extents = malloc((2*r + 1) * sizeof(*cpu->inner_extents));
+    cpu->outer_extents = malloc((2*r + 1) * sizeof(*cpu->outer_extents));
+    assert(cpu->padded != NULL && cpu->prefix != NULL && "Buy MORE RAM lol!!");
+    assert(cpu->inner_extents != NULL && cpu->outer_extents != NULL && "Buy MORE RAM lol!!");
+
+    for (int dy = -r; dy <= r; ++dy) {
+        cpu->inner_extents[dy + r] = smoothlife_span_extent(ri * ri, dy);
+        cpu->outer_extents[dy + r] = smoothlife_span_extent(ra * ra, dy);
+    }
+}
+
+static void smoothlife_direct_start(SmoothLife_Cpu *cpu) {
+    float ra = cpu->rules.ra;
+    float ri = ra / 3.0f;
+    int r = (int)floorf(ra);
+    cpu->pad = r;
+    cpu->padded_width = cpu->width + 2*r;
+    cpu->padded = malloc(cpu->padded_width * (cpu->height + 2*r) * sizeof(*cpu->padded));
+    size_t window = (2*r + 1) * (2*r + 1);
+    cpu->inner_offsets = malloc(window * sizeof(*cpu->inner_offsets));
+    cpu->outer_offsets = malloc(window * sizeof(*cpu->outer_offsets));
+    assert(cpu->padded != NULL && cpu->inner_offsets != NULL && cpu->outer_offsets != NULL && "Buy MORE RAM lol!!");
+
+    // The same cells as the loop in smoothlife.fs
+    for (int dy = -r; dy <= r; ++dy) {
+        for (int dx = -r; dx <= r; ++dx) {
+            float dist_sq = (float)(dx*dx + dy*dy);
+            ptrdiff_t offset = (ptrdiff_t)dy * (ptrdiff_t)cpu->padded_width + dx;
+            if (dist_sq <= ri * ri) {
+                cpu->inner_offsets[cpu->inner_count++] = offset;
+            } else if (dist_sq <= ra * ra) {
+                cpu->outer_offsets[cpu->outer_count++] = offset;
+            }
+        }
+    }
+
+#if defined(SMOOTHLIFE_CPU_X86)
+    __builtin_cpu_init();
+    cpu->avx2 = __builtin_cpu_supports("avx2");
+#endif
+}
+
+static void smoothlife_fft_start(SmoothLife_Cpu *cpu) {
+    size_t width = cpu->width;
+    size_t height = cpu->height;
+    cpu->fft_rows = fft_start(width);
+    cpu->fft_cols = fft_start(height);
+    cpu->spectrum = malloc(width * height * sizeof(*cpu->spectrum));
+    cpu->kernel_spectrum = calloc(width * height, sizeof(*cpu->kernel_spectrum));
+    assert(cpu->spectrum != NULL && cpu->kernel_spectrum != NULL && "Buy MORE RAM lol!!");
+
+    // Same cells and areas as the loop in smoothlife.fs, wrapping around like the texture
+    float ra = cpu->rules.ra;
+    float ri = ra / 3.0f;
+    float inner_area = PI_F * ri * ri;
+    float outer_area = PI_F * ra * ra - inner_area;
+    int r = (int)floorf(ra);
+    Fft_Complex *kernel = cpu->kernel_spectrum;
+    for (int dy = -r; dy <= r; ++dy) {
+        for (int dx = -r; dx <= r; ++dx) {
+            float dist_sq = (float)(dx*dx + dy*dy);
+            size_t x = ((dx % (int)width) + width) % width;
+            size_t y = ((dy % (int)height) + height) % height;
+            if (dist_sq <= ri * ri) {
+                kernel[y * width + x].re += 1.0f / inner_area;
+            } else if (dist_sq <= ra * ra) {
+                kernel[y * width + x].im += 1.0f / outer_area;
+            }
+        }
+    }
+
+    // Transformed once, the normalization of the inverse FFT goes into it as well
+    Fft_Complex *line = cpu->scratch;
+    Fft_Complex *transformed = line + cpu->scratch_stride / 2;
+    float scale = 1.0f / (float)(width * height);
+    for (size_t y = 0; y < height; ++y) {
+        memcpy(line, kernel + y * width, width * sizeof(*line));
+        fft_forward(cpu->fft_rows, line, kernel + y * width);
+    }
+    for (size_t x = 0; x < width; ++x) {
+        for (size_t y = 0; y < height; ++y) line[y] = kernel[y * width + x];
+        fft_forward(cpu->fft_cols, line, transformed);
+        for (size_t y = 0; y < height; ++y) {
+            kernel[y * width + x] = (Fft_Complex){ transformed[y].re * scale, transformed[y].im * scale };
+        }
+    }
+}
+
+SmoothLife_Cpu *smoothlife_cpu_start(size_t width, size_t height, SmoothLife_Rules rules, SmoothLife_Kernel kernel, size_t threads) {
+    SmoothLife_Cpu *cpu = calloc(1, sizeof(SmoothLife_Cpu));
+    assert(cpu != NULL && "Buy MORE RAM lol!!");
+    cpu->width = width;
+    cpu->height = height;
+    cpu->rules = rules;
+    cpu->kernel = kernel;
+    cpu->grid = calloc(width * height, sizeof(*cpu->grid));
+    assert(cpu->grid != NULL && "Buy MORE RAM lol!!");
+
+    if (threads == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? cpus : 1;
+    }
+    cpu->pool = thread_pool_start(threads, "smoothlife worker");
+    threads = thread_pool_threads(cpu->pool);
+
+    cpu->scratch_stride = 2 * (width > height ? width : height);
+    cpu->scratch = malloc(threads * cpu->scratch_stride * sizeof(*cpu->scratch));
+    assert(cpu->scratch != NULL && "Buy MORE RAM lol!!");
+
+    switch (kernel) {
+    case SMOOTHLIFE_KERNEL_FFT: smoothlife_fft_start(cpu); break;
+    case SMOOTHLIFE_KERNEL_DIRECT: smoothlife_direct_start(cpu); break;
+    case SMOOTHLIFE_KERNEL_SPANS: smoothlife_spans_start(cpu); break;
+    }
+
+    return cpu;
+}
+
+void smoothlife_cpu_end(SmoothLife_Cpu *cpu) {
+    thread_pool_end(cpu->pool);
+
+    if (cpu->fft_rows != NULL) fft_end(cpu->fft_rows);
+    if (cpu->fft_cols != NULL) fft_end(cpu->fft_cols);
+    free(cpu->spectrum);
+    free(cpu->kernel_spectrum);
+    free(cpu->padded);
+    free(cpu->inner_offsets);
+    free(cpu->outer_offsets);
+    free(cpu->prefix);
+    free(cpu->inner_extents);
+    free(cpu->outer_extents);
+    free(cpu->scratch);
+    free(cpu->grid);
+    free(cpu);
+}
+
+float *smoothlife_cpu_grid(SmoothLife_Cpu *cpu) {
+    return cpu->grid;
+}
+
+void smoothlife_cpu_step(SmoothLife_Cpu *cpu, float dt) {
+    TRACE_SCOPE("smoothlife_cpu_step");
+    cpu->dt = dt;
+    switch (cpu->kernel) {
+    case SMOOTHLIFE_KERNEL_FFT:
+        thread_pool_run(cpu->pool, smoothlife_fft_rows_forward, cpu, (cpu->height + 1) / 2);
+        thread_pool_run(cpu->pool, smoothlife_fft_columns, cpu, cpu->width);
+        thread_pool_run(cpu->pool, smoothlife_fft_rows_step, cpu, cpu->height);
+        break;
+    case SMOOTHLIFE_KERNEL_DIRECT:
+        thread_pool_run(cpu->pool, smoothlife_direct_pad, cpu, cpu->height + 2*cpu->pad);
+        thread_pool_run(cpu->pool, smoothlife_direct_rows, cpu, cpu->height);
+        break;
+    case SMOOTHLIFE_KERNEL_SPANS:
+        thread_pool_run(cpu->pool, smoothlife_spans_pad, cpu, cpu->height + 2*cpu->pad);
+        thread_pool_run(cpu->pool, smoothlife_spans_rows, cpu, cpu->height);
+        break;
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef SMOOTHLIFE_CPU_H_
+#define SMOOTHLIFE_CPU_H_
+
+#include <stddef.h>
+
+// Parameters of the SmoothLife rule, the same as in assets/shaders/smoothlife.fs
+typedef struct {
+    float ra;        // Outer radius of the neighbourhood, the inner disk has ra/3
+    float b1, b2;    // Birth interval
+    float d1, d2;    // Death interval
+    float alpha_n;
+    float alpha_m;
+} SmoothLife_Rules;
+
+#define SMOOTHLIFE_RULES_DEFAULT ((SmoothLife_Rules) { \
+    .ra = 21.0f,                                       \
+    .b1 = 0.257f, .b2 = 0.336f,                        \
+    .d1 = 0.365f, .d2 = 0.549f,                        \
+    .alpha_n = 0.028f, .alpha_m = 0.147f,              \
+})
+
+typedef enum {
+    // Both neighbourhood integrals with one FFT convolution, O(N log N) for any radius
+    SMOOTHLIFE_KERNEL_FFT,
+    // Sums every cell of the disk like smoothlife.fs, vectorized across columns, O(N ra^2)
+    SMOOTHLIFE_KERNEL_DIRECT,
+    // Exact disk sums from per-row prefix sums, one span per row of the disk, O(N ra)
+    SMOOTHLIFE_KERNEL_SPANS,
+} SmoothLife_Kernel;
+
+// Half width of the row dy of the disk with radius_sq, -1 when the row misses the disk.
+// The same cells as `dx*dx + dy*dy <= radius_sq` in smoothlife.fs.
+int smoothlife_span_extent(float radius_sq, int dy);
+
+// SmoothLife on a float grid in main memory, stepped by a pool of threads
+typedef struct SmoothLife_Cpu SmoothLife_Cpu;
+
+// threads = 0 uses all cores
+SmoothLife_Cpu *smoothlife_cpu_start(size_t width, size_t height, SmoothLife_Rules rules, SmoothLife_Kernel kernel, size_t threads);
+void smoothlife_cpu_end(SmoothLife_Cpu *cpu);
+// width x height cells in [0, 1] row by row, the grid wraps around at its edges
+float *smoothlife_cpu_grid(SmoothLife_Cpu *cpu);
+void smoothlife_cpu_step(SmoothLife_Cpu *cpu, float dt);
+
+#endif // SMOOTHLIFE_CPU_H_
@@ -0,0 +1,133 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "thread_pool.h"
+#include "trace.h"
+
+#define THREAD_POOL_MAX_THREADS 64
+
+typedef struct {
+    Thread_Pool *pool;
+    size_t index;
+} Thread_Pool_Worker;
+
+struct Thread_Pool {
+    const char *name;
+    // The calling thread of thread_pool_run() takes band 0 of every job
+    size_t threads;
+    pthread_t workers[THREAD_POOL_MAX_THREADS];
+    Thread_Pool_Worker worker_args[THREAD_POOL_MAX_THREADS];
+    pthread_mutex_t mutex;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    Thread_Pool_Job job;
+    void *user;
+    size_t count;
+    size_t generation;
+    size_t pending;
+    bool stopping;
+};
+
+static void thread_pool_band(Thread_Pool *pool, Thread_Pool_Job job, void *user, size_t count, size_t band) {
+    size_t per_band = (count + pool->threads - 1) / pool->threads;
+    size_t begin = band * per_band;
+    size_t end = begin + per_band;
+    if (begin > count) begin = count;
+    if (end > count) end = count;
+    if (begin < end) job(user, begin, end, band);
+}
+
+static void *thread_pool_worker(void *arg) {
+    Thread_Pool_Worker *worker = arg;
+    Thread_Pool *pool = worker->pool;
+    trace_thread_name(pool->name);
+
+    size_t seen = 0;
+    pthread_mutex_lock(&pool->mutex);
+    for (;;) {
+        while (pool->generation == seen && !pool->stopping) {
+            pthread_cond_wait(&pool->start, &pool->mutex);
+        }
+        if (pool->stopping) break;
+        seen = pool->generation;
+        Thread_Pool_Job job = pool->job;
+        void *user = pool->user;
+        size_t count = pool->count;
+        pthread_mutex_unlock(&pool->mutex);
+
+        thread_pool_band(pool, job, user, count, worker->index);
+
+        pthread_mutex_lock(&pool->mutex);
+        pool->pending -= 1;
+        if (pool->pending == 0) pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return NULL;
+}
+
+Thread_Pool *thread_pool_start(size_t threads, const char *name) {
+    Thread_Pool *pool = calloc(1, sizeof(Thread_Pool));
+    assert(pool != NULL && "Buy MORE RAM lol!!");
+    if (threads < 1) threads = 1;
+    if (threads > THREAD_POOL_MAX_THREADS) threads = THREAD_POOL_MAX_THREADS;
+    pool->name = name;
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    // Bands are only handed to the workers that actually started
+    pool->threads = 1;
+    for (size_t i = 1; i < threads; ++i) {
+        pool->worker_args[i] = (Thread_Pool_Worker) { .pool = pool, .index = i };
+        if (pthread_create(&pool->workers[i], NULL, thread_pool_worker, &pool->worker_args[i]) != 0) break;
+        pool->threads += 1;
+    }
+    return pool;
+}
+
+void thread_pool_end(Thread_Pool *pool) {
+    if (pool == NULL) return;
+    pthread_mutex_lock(&pool->mutex);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->mutex);
+    for (size_t i = 1; i < pool->threads; ++i) {
+        pthread_join(pool->workers[i], NULL);
+    }
+    pthread_mutex_destroy(&pool->mutex);
+    pthread_cond_destroy(&pool->start);
+    pthread_cond_destroy(&pool->done);
+    free(pool);
+}
+
+size_t thread_pool_threads(Thread_Pool *pool) {
+    return pool != NULL ? pool->threads : 1;
+}
+
+void thread_pool_run(Thread_Pool *pool, Thread_Pool_Job job, void *user, size_t count) {
+    if (pool == NULL) {
+        if (count > 0) job(user, 0, count, 0);
+        return;
+    }
+
+    if (pool->threads > 1) {
+        pthread_mutex_lock(&pool->mutex);
+        pool->job = job;
+        pool->user = user;
+        pool->count = count;
+        pool->pending = pool->threads - 1;
+        pool->generation += 1;
+        pthread_cond_broadcast(&pool->start);
+        pthread_mutex_unlock(&pool->mutex);
+    }
+
+    thread_pool_band(pool, job, user, count, 0);
+
+    if (pool->threads > 1) {
+        pthread_mutex_lock(&pool->mutex);
+        while (pool->pending > 0) pthread_cond_wait(&pool->done, &pool->mutex);
+        pthread_mutex_unlock(&pool->mutex);
+    }
+}
@@ -0,0 +1,27 @@
+#ifndef THREAD_POOL_H_
+#define THREAD_POOL_H_
+
+#include <stddef.h>
+
+// Persistent worker threads for splitting a loop into bands. The threads are
+// started once and sleep between jobs, so the hot paths (frame conversion,
+// PNG deflate, image diffs) do not pay for pthread_create on every call.
+
+typedef struct Thread_Pool Thread_Pool;
+
+// Processes [begin, end) of the job, band is in [0, thread_pool_threads())
+// and can index per-thread scratch memory
+typedef void (*Thread_Pool_Job)(void *user, size_t begin, size_t end, size_t band);
+
+// Starts threads - 1 workers, the calling thread of thread_pool_run() is the
+// last one. Shows up as name in traces. Never fails: workers that cannot be
+// created just leave fewer bands.
+Thread_Pool *thread_pool_start(size_t threads, const char *name);
+void thread_pool_end(Thread_Pool *pool);
+// A NULL pool counts as a single thread
+size_t thread_pool_threads(Thread_Pool *pool);
+// Splits [0, count) into one band per thread and waits for all of them.
+// With a NULL pool the whole range runs on the calling thread.
+void thread_pool_run(Thread_Pool *pool, Thread_Pool_Job job, void *user, size_t count);
+
+#endif // THREAD_POOL_H_
@@ -0,0 +1,77 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+#include <raylib.h>
+#include <rlgl.h>
+#include "tiled.h"
+
+size_t tiled_tile_size(size_t max_tile_size) {
+    GLint max_texture_size = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_texture_size);
+    if (max_texture_size > 0 && (size_t)max_texture_size < max_tile_size) return max_texture_size;
+    return max_tile_size;
+}
+
+static void tiled_flip_rows(uint8_t *rows, size_t stride, size_t count, uint8_t *scratch) {
+    for (size_t top = 0, bottom = count - 1; top < bottom; ++top, --bottom) {
+        memcpy(scratch, rows + top * stride, stride);
+        memcpy(rows + top * stride, rows + bottom * stride, stride);
+        memcpy(rows + bottom * stride, scratch, stride);
+    }
+}
+
+bool tiled_render(size_t width, size_t height, size_t tile_size, Tiled_Draw draw, Tiled_Rows rows, void *user) {
+    RenderTexture2D tile = LoadRenderTexture(tile_size, tile_size);
+    if (tile.id == 0) {
+        TraceLog(LOG_ERROR, "TILED: could not create a %zux%zu tile", tile_size, tile_size);
+        return false;
+    }
+
+    size_t stride = 4 * width;
+    uint8_t *strip = malloc(stride * tile_size);
+    uint8_t *scratch = malloc(stride);
+    assert(strip != NULL && scratch != NULL && "Buy MORE RAM lol!!");
+
+    bool ok = true;
+    bool first = true;
+    for (size_t ty = 0; ok && ty < height; ty += tile_size) {
+        size_t th = height - ty < tile_size ? height - ty : tile_size;
+        for (size_t tx = 0; tx < width; tx += tile_size) {
+            size_t tw = width - tx < tile_size ? width - tx : tile_size;
+
+            BeginTextureMode(tile);
+            // Map the tile's part of the full frame onto the tile, the rest gets clipped
+            rlViewport(0, 0, tw, th);
+            rlMatrixMode(RL_PROJECTION);
+            rlLoadIdentity();
+            rlOrtho(tx, tx + tw, ty + th, ty, 0.0f, 1.0f);
+            rlMatrixMode(RL_MODELVIEW);
+            rlLoadIdentity();
+            // gl_FragCoord starts at the bottom left of the tile
+            draw(user, width, height, tx, height - ty - th, first);
+            EndTextureMode();
+            first = false;
+
+            // Rows come out bottom-up straight into their columns of the strip
+            rlBindFramebuffer(RL_READ_FRAMEBUFFER, tile.id);
+            glPixelStorei(GL_PACK_ALIGNMENT, 1);
+            glPixelStorei(GL_PACK_ROW_LENGTH, width);
+            glReadPixels(0, 0, tw, th, GL_RGBA, GL_UNSIGNED_BYTE, strip + 4 * tx);
+            glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+            rlBindFramebuffer(RL_READ_FRAMEBUFFER, 0);
+        }
+
+        tiled_flip_rows(strip, stride, th, scratch);
+        ok = rows(user, strip, width, th);
+    }
+
+    free(scratch);
+    free(strip);
+    UnloadRenderTexture(tile);
+    return ok;
+}
@@ -0,0 +1,26 @@
+#ifndef TILED_H_
+#define TILED_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Draws the full width x height frame. The projection is already set up
+// to clip everything outside of the current tile. offset_x/offset_y is
+// where gl_FragCoord (0, 0) of the tile sits within the full frame, counted
+// from its bottom left like gl_FragCoord. first is set for the first tile of
+// a frame only, so animations advance once per frame.
+typedef void (*Tiled_Draw)(void *user, size_t width, size_t height, float offset_x, float offset_y, bool first);
+// Receives `count` consecutive RGBA8 rows of the final image, top to bottom,
+// each `width` pixels wide. Returning false aborts the rendering.
+typedef bool (*Tiled_Rows)(void *user, const uint8_t *rows, size_t width, size_t count);
+
+// Largest tile size the driver can render into, capped at max_tile_size
+size_t tiled_tile_size(size_t max_tile_size);
+
+// Renders one width x height frame as a grid of tile_size tiles, so the
+// frame can exceed the maximum texture size. Only a single tile lives on
+// the GPU and a strip of tile_size rows on the CPU.
+bool tiled_render(size_t width, size_t height, size_t tile_size, Tiled_Draw draw, Tiled_Rows rows, void *user);
+
+#endif // TILED_H_
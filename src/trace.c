@@ -0,0 +1,210 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <raylib.h>
+#include "trace.h"
+
+// Spans kept per thread, older ones get overwritten
+#define TRACE_RING_EVENTS (16*1024)
+// Deeper nesting is not recorded
+#define TRACE_MAX_DEPTH 64
+// Distinct span names copied per thread, further ones are recorded under TRACE_NAMES_FULL
+#define TRACE_NAMES_CAPACITY 256
+#define TRACE_NAMES_FULL "(too many span names)"
+
+typedef struct {
+    const char *name;
+    double start;     // Microseconds since trace_start()
+    double duration;
+} Trace_Event;
+
+// Maps the caller's name pointer to a copy owned by the trace, so names
+// from plugins survive the plugin being unloaded by a hot reload
+typedef struct {
+    const char *key;
+    char *copy;
+} Trace_Name;
+
+typedef struct Trace_Thread Trace_Thread;
+struct Trace_Thread {
+    size_t tid;
+    const char *name;
+    Trace_Event events[TRACE_RING_EVENTS];
+    size_t written;
+    const char *open_names[TRACE_MAX_DEPTH];
+    double open_starts[TRACE_MAX_DEPTH];
+    size_t depth;
+    Trace_Name names[TRACE_NAMES_CAPACITY];
+    // Every copy ever made, a replaced one may still be referenced by events
+    char **copies;
+    size_t copies_count;
+    Trace_Thread *next;
+};
+
+static bool trace_enabled = false;
+static char *trace_path = NULL;
+static double trace_origin = 0;
+
+// Buffers outlive their threads, they are only freed by trace_stop()
+static pthread_mutex_t trace_threads_mutex = PTHREAD_MUTEX_INITIALIZER;
+static Trace_Thread *trace_threads = NULL;
+static size_t trace_threads_count = 0;
+static _Thread_local Trace_Thread *trace_thread = NULL;
+// Every trace_start() begins a new generation, buffers of older ones are gone
+static size_t trace_generation = 0;
+static _Thread_local size_t trace_thread_generation = 0;
+
+static double trace_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1e6 + ts.tv_nsec*1e-3;
+}
+
+static Trace_Thread *trace_get_thread(void) {
+    if (trace_thread == NULL || trace_thread_generation != trace_generation) {
+        trace_thread_generation = trace_generation;
+        trace_thread = calloc(1, sizeof(Trace_Thread));
+        assert(trace_thread != NULL && "Buy MORE RAM lol!!");
+        pthread_mutex_lock(&trace_threads_mutex);
+        trace_thread->tid = ++trace_threads_count;
+        trace_thread->next = trace_threads;
+        trace_threads = trace_thread;
+        pthread_mutex_unlock(&trace_threads_mutex);
+    }
+    return trace_thread;
+}
+
+// Only compares the pointers and the short strings behind them, a plugin
+// reloaded at the same address with other names gets fresh copies
+static const char *trace_intern(Trace_Thread *thread, const char *name) {
+    size_t hash = ((uintptr_t)name >> 3) % TRACE_NAMES_CAPACITY;
+    for (size_t i = 0; i < TRACE_NAMES_CAPACITY; ++i) {
+        Trace_Name *slot = &thread->names[(hash + i) % TRACE_NAMES_CAPACITY];
+        if (slot->key != NULL && slot->key != name) continue;
+        if (slot->key == name && strcmp(slot->copy, name) == 0) return slot->copy;
+
+        char *copy = strdup(name);
+        assert(copy != NULL && "Buy MORE RAM lol!!");
+        thread->copies = realloc(thread->copies, (thread->copies_count + 1) * sizeof(*thread->copies));
+        assert(thread->copies != NULL && "Buy MORE RAM lol!!");
+        thread->copies[thread->copies_count++] = copy;
+        slot->key = name;
+        slot->copy = copy;
+        return copy;
+    }
+    return TRACE_NAMES_FULL;
+}
+
+void trace_start(const char *path) {
+    free(trace_path);
+    trace_path = strdup(path);
+    assert(trace_path != NULL && "Buy MORE RAM lol!!");
+    trace_origin = trace_now();
+    trace_generation += 1;
+    __atomic_store_n(&trace_enabled, true, __ATOMIC_RELEASE);
+}
+
+bool trace_is_enabled(void) {
+    return __atomic_load_n(&trace_enabled, __ATOMIC_RELAXED);
+}
+
+void trace_begin(const char *name) {
+    if (!trace_is_enabled()) return;
+    Trace_Thread *thread = trace_get_thread();
+    if (thread->depth < TRACE_MAX_DEPTH) {
+        thread->open_names[thread->depth] = trace_intern(thread, name);
+        thread->open_starts[thread->depth] = trace_now();
+    }
+    thread->depth += 1;
+}
+
+void trace_end(void) {
+    if (!trace_is_enabled()) return;
+    Trace_Thread *thread = trace_get_thread();
+    // Spans opened before trace_start() have nothing to close
+    if (thread->depth == 0) return;
+    thread->depth -= 1;
+    if (thread->depth >= TRACE_MAX_DEPTH) return;
+
+    Trace_Event *event = &thread->events[thread->written % TRACE_RING_EVENTS];
+    event->name = thread->open_names[thread->depth];
+    event->start = thread->open_starts[thread->depth] - trace_origin;
+    event->duration = trace_now() - thread->open_starts[thread->depth];
+    thread->written += 1;
+}
+
+void trace_thread_name(const char *name) {
+    if (!trace_is_enabled()) return;
+    Trace_Thread *thread = trace_get_thread();
+    thread->name = trace_intern(thread, name);
+}
+
+static void trace_write_string(FILE *f, const char *s) {
+    fputc('"', f);
+    for (; *s != '\0'; ++s) {
+        if (*s == '"' || *s == '\\') fputc('\\', f);
+        fputc(*s, f);
+    }
+    fputc('"', f);
+}
+
+bool trace_stop(void) {
+    if (!trace_is_enabled()) return true;
+    __atomic_store_n(&trace_enabled, false, __ATOMIC_RELEASE);
+
+    bool ok = true;
+    FILE *f = fopen(trace_path, "w");
+    if (f == NULL) {
+        TraceLog(LOG_ERROR, "TRACE: could not create %s: %s", trace_path, strerror(errno));
+        ok = false;
+    }
+
+    pthread_mutex_lock(&trace_threads_mutex);
+    if (f != NULL) {
+        fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        bool first = true;
+        for (Trace_Thread *thread = trace_threads; thread != NULL; thread = thread->next) {
+            if (thread->name != NULL) {
+                fprintf(f, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%zu,\"args\":{\"name\":", first ? "" : ",\n", thread->tid);
+                trace_write_string(f, thread->name);
+                fprintf(f, "}}");
+                first = false;
+            }
+            size_t count = thread->written < TRACE_RING_EVENTS ? thread->written : TRACE_RING_EVENTS;
+            for (size_t i = thread->written - count; i < thread->written; ++i) {
+                Trace_Event *event = &thread->events[i % TRACE_RING_EVENTS];
+                fprintf(f, "%s{\"ph\":\"X\",\"name\":", first ? "" : ",\n");
+                trace_write_string(f, event->name);
+                fprintf(f, ",\"pid\":1,\"tid\":%zu,\"ts\":%.3f,\"dur\":%.3f}", thread->tid, event->start, event->duration);
+                first = false;
+            }
+        }
+        fprintf(f, "\n]}\n");
+        if (fclose(f) != 0) {
+            TraceLog(LOG_ERROR, "TRACE: could not write %s: %s", trace_path, strerror(errno));
+            ok = false;
+        } else {
+            TraceLog(LOG_INFO, "TRACE: saved trace as %s", trace_path);
+        }
+    }
+
+    while (trace_threads != NULL) {
+        Trace_Thread *next = trace_threads->next;
+        for (size_t i = 0; i < trace_threads->copies_count; ++i) free(trace_threads->copies[i]);
+        free(trace_threads->copies);
+        free(trace_threads);
+        trace_threads = next;
+    }
+    trace_threads_count = 0;
+    pthread_mutex_unlock(&trace_threads_mutex);
+
+    free(trace_path);
+    trace_path = NULL;
+    return ok;
+}
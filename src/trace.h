@@ -0,0 +1,38 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <stdbool.h>
+
+// Scoped timers dumped as Chrome trace events (chrome://tracing, ui.perfetto.dev).
+// Built as libtrace.so so main and the plugins record into the same buffers.
+//
+// Every thread records its spans into its own ring buffer that keeps the
+// most recent TRACE_RING_EVENTS spans. While tracing is disabled
+// trace_begin()/trace_end() return right away without touching any memory.
+// Span and thread names are copied on first use, so plugins may pass string
+// literals and still be unloaded while tracing.
+
+// Enables tracing, the events are written into path by trace_stop()
+void trace_start(const char *path);
+// Disables tracing and dumps the events. Threads still recording at this
+// point may lose their last spans, stop worker threads first.
+bool trace_stop(void);
+bool trace_is_enabled(void);
+
+void trace_begin(const char *name);
+void trace_end(void);
+// Shows up instead of the thread id in the trace viewer
+void trace_thread_name(const char *name);
+
+static inline void trace_scope_end(const char **name) {
+    (void)name;
+    trace_end();
+}
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+// Traces the rest of the enclosing block
+#define TRACE_SCOPE(name) \
+    __attribute__((cleanup(trace_scope_end))) const char *TRACE_CONCAT(trace_scope_, __LINE__) = (trace_begin(name), name)
+
+#endif // TRACE_H_
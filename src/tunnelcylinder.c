@@ -16,12 +16,14 @@ typedef struct {
     int timeLoc;
     int resolutionLoc;
     int originLoc;
+    int tileOffsetLoc;
 } Info;
 
 typedef struct {
     Shader shader;
     int timeLoc;
     int resolutionLoc;
+    int tileOffsetLoc;
 } TunnelCylinder;
 
 typedef struct {
@@ -34,17 +36,20 @@ typedef struct {
 } Plug;
 
 static Plug *p = NULL;
+static Vector2 tile_offset = {0};
 
 static void load_resources(void) {
     p->font = LoadFontEx("./assets/fonts/iosevka-regular.ttf", FONT_SIZE, NULL, 0);
     p->tc.shader = LoadShader(0, "./assets/shaders/tunnelCylinders.fs");
     p->tc.timeLoc = GetShaderLocation(p->tc.shader, "time");
     p->tc.resolutionLoc = GetShaderLocation(p->tc.shader, "resolution");
+    p->tc.tileOffsetLoc = GetShaderLocation(p->tc.shader, "tileOffset");
 
     p->info.shader = LoadShader(0, "./assets/shaders/info.fs");
     p->info.timeLoc = GetShaderLocation(p->info.shader, "u_time");
     p->info.resolutionLoc = GetShaderLocation(p->info.shader, "u_resolution");
     p->info.originLoc = GetShaderLocation(p->info.shader, "u_origin");
+    p->info.tileOffsetLoc = GetShaderLocation(p->info.shader, "u_tile_offset");
     p->info.text = "Made by realsanjeev";
 
     if (p->info.originLoc == -1) {
@@ -62,6 +67,11 @@ void plug_reset(void) {
     p->time = 0.0f;
 }
 
+// Offset of gl_FragCoord when main renders the frame in tiles, see tiled.h
+void plug_set_tile(float x, float y) {
+    tile_offset = (Vector2){x, y};
+}
+
 void plug_init(void) {
     if (!p) {
         p = calloc(1, sizeof(Plug));
@@ -138,6 +148,7 @@ void plug_update(float dt, float w, float h) {
     BeginShaderMode(p->tc.shader);
         SetShaderValue(p->tc.shader, p->tc.timeLoc, &p->time, SHADER_UNIFORM_FLOAT);
         SetShaderValue(p->tc.shader, p->tc.resolutionLoc, resolution, SHADER_UNIFORM_VEC2);
+        SetShaderValue(p->tc.shader, p->tc.tileOffsetLoc, &tile_offset, SHADER_UNIFORM_VEC2);
         DrawRectangle(0, 0, w, h, WHITE);
     EndShaderMode();
 
@@ -157,6 +168,7 @@ void plug_update(float dt, float w, float h) {
         SetShaderValue(p->info.shader, p->info.timeLoc, &p->time, SHADER_UNIFORM_FLOAT);
         SetShaderValue(p->info.shader, p->info.resolutionLoc, infoResolution, SHADER_UNIFORM_VEC2);
         SetShaderValue(p->info.shader, p->info.originLoc, origin, SHADER_UNIFORM_VEC2);
+        SetShaderValue(p->info.shader, p->info.tileOffsetLoc, &tile_offset, SHADER_UNIFORM_VEC2);
         DrawRectangleRec(textBounds, BLANK);
     EndShaderMode();
 
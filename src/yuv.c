@@ -0,0 +1,245 @@
+#include <assert.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// The AVX2 path is picked at runtime, so it is built on every x86 target
+#if defined(__x86_64__) || defined(__i386__)
+#define YUV_X86
+#include <immintrin.h>
+#endif
+
+#include "yuv.h"
+
+typedef struct {
+    const uint8_t *rgba;
+    size_t width;
+    size_t height;
+    bool flipped;
+    uint8_t *yuv;
+    bool avx2;
+} YUV_Frame;
+
+size_t yuv420p_size(size_t width, size_t height) {
+    size_t chroma_width = (width + 1) / 2;
+    size_t chroma_height = (height + 1) / 2;
+    return width * height + 2 * chroma_width * chroma_height;
+}
+
+static inline uint8_t luma(int r, int g, int b) {
+    return ((66*r + 129*g + 25*b + 128) >> 8) + 16;
+}
+
+static inline uint8_t chroma_u(int r, int g, int b) {
+    return ((-38*r - 74*g + 112*b + 128) >> 8) + 128;
+}
+
+static inline uint8_t chroma_v(int r, int g, int b) {
+    return ((112*r - 94*g - 18*b + 128) >> 8) + 128;
+}
+
+#if defined(__SSE2__)
+// Splits 8 RGBA pixels into 16-bit R, G and B lanes
+static inline void deinterleave8(const uint8_t *src, __m128i *r, __m128i *g, __m128i *b) {
+    __m128i mask = _mm_set1_epi32(0xff);
+    __m128i p0 = _mm_loadu_si128((const __m128i*)src);
+    __m128i p1 = _mm_loadu_si128((const __m128i*)(src + 16));
+    *r = _mm_packs_epi32(_mm_and_si128(p0, mask), _mm_and_si128(p1, mask));
+    *g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 8), mask), _mm_and_si128(_mm_srli_epi32(p1, 8), mask));
+    *b = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 16), mask), _mm_and_si128(_mm_srli_epi32(p1, 16), mask));
+}
+
+// 66*255 + 129*255 + 25*255 + 128 still fits in an unsigned 16-bit lane
+static inline __m128i luma8(__m128i r, __m128i g, __m128i b) {
+    __m128i y = _mm_mullo_epi16(r, _mm_set1_epi16(66));
+    y = _mm_add_epi16(y, _mm_mullo_epi16(g, _mm_set1_epi16(129)));
+    y = _mm_add_epi16(y, _mm_mullo_epi16(b, _mm_set1_epi16(25)));
+    y = _mm_srli_epi16(_mm_add_epi16(y, _mm_set1_epi16(128)), 8);
+    return _mm_add_epi16(y, _mm_set1_epi16(16));
+}
+
+// Averages horizontal pairs of two rows into 4 values, duplicated into 8 lanes
+static inline __m128i average2x2(__m128i top, __m128i bottom) {
+    __m128i ones = _mm_set1_epi16(1);
+    __m128i sum = _mm_add_epi32(_mm_madd_epi16(top, ones), _mm_madd_epi16(bottom, ones));
+    sum = _mm_srli_epi32(_mm_add_epi32(sum, _mm_set1_epi32(2)), 2);
+    return _mm_packs_epi32(sum, sum);
+}
+
+// The chroma sums stay within [-28560, 28688], so signed 16-bit lanes suffice
+static inline __m128i chroma8(__m128i r, __m128i g, __m128i b, short kr, short kg, short kb) {
+    __m128i c = _mm_mullo_epi16(r, _mm_set1_epi16(kr));
+    c = _mm_add_epi16(c, _mm_mullo_epi16(g, _mm_set1_epi16(kg)));
+    c = _mm_add_epi16(c, _mm_mullo_epi16(b, _mm_set1_epi16(kb)));
+    c = _mm_srai_epi16(_mm_add_epi16(c, _mm_set1_epi16(128)), 8);
+    return _mm_add_epi16(c, _mm_set1_epi16(128));
+}
+#endif
+
+#if defined(YUV_X86)
+// The same as the SSE2 helpers on 16 pixels. The 256-bit packs work within
+// 128-bit lanes, so their results are put back in pixel order with a permute.
+__attribute__((target("avx2")))
+static inline void deinterleave16(const uint8_t *src, __m256i *r, __m256i *g, __m256i *b) {
+    __m256i mask = _mm256_set1_epi32(0xff);
+    __m256i p0 = _mm256_loadu_si256((const __m256i*)src);
+    __m256i p1 = _mm256_loadu_si256((const __m256i*)(src + 32));
+    *r = _mm256_packs_epi32(_mm256_and_si256(p0, mask), _mm256_and_si256(p1, mask));
+    *g = _mm256_packs_epi32(_mm256_and_si256(_mm256_srli_epi32(p0, 8), mask), _mm256_and_si256(_mm256_srli_epi32(p1, 8), mask));
+    *b = _mm256_packs_epi32(_mm256_and_si256(_mm256_srli_epi32(p0, 16), mask), _mm256_and_si256(_mm256_srli_epi32(p1, 16), mask));
+    *r = _mm256_permute4x64_epi64(*r, _MM_SHUFFLE(3, 1, 2, 0));
+    *g = _mm256_permute4x64_epi64(*g, _MM_SHUFFLE(3, 1, 2, 0));
+    *b = _mm256_permute4x64_epi64(*b, _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i luma16(__m256i r, __m256i g, __m256i b) {
+    __m256i y = _mm256_mullo_epi16(r, _mm256_set1_epi16(66));
+    y = _mm256_add_epi16(y, _mm256_mullo_epi16(g, _mm256_set1_epi16(129)));
+    y = _mm256_add_epi16(y, _mm256_mullo_epi16(b, _mm256_set1_epi16(25)));
+    y = _mm256_srli_epi16(_mm256_add_epi16(y, _mm256_set1_epi16(128)), 8);
+    return _mm256_add_epi16(y, _mm256_set1_epi16(16));
+}
+
+// Averages horizontal pairs of two rows into 8 values, duplicated into 16 lanes
+__attribute__((target("avx2")))
+static inline __m256i average2x2_16(__m256i top, __m256i bottom) {
+    __m256i ones = _mm256_set1_epi16(1);
+    __m256i sum = _mm256_add_epi32(_mm256_madd_epi16(top, ones), _mm256_madd_epi16(bottom, ones));
+    sum = _mm256_srli_epi32(_mm256_add_epi32(sum, _mm256_set1_epi32(2)), 2);
+    return _mm256_permute4x64_epi64(_mm256_packs_epi32(sum, sum), _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i chroma16(__m256i r, __m256i g, __m256i b, short kr, short kg, short kb) {
+    __m256i c = _mm256_mullo_epi16(r, _mm256_set1_epi16(kr));
+    c = _mm256_add_epi16(c, _mm256_mullo_epi16(g, _mm256_set1_epi16(kg)));
+    c = _mm256_add_epi16(c, _mm256_mullo_epi16(b, _mm256_set1_epi16(kb)));
+    c = _mm256_srai_epi16(_mm256_add_epi16(c, _mm256_set1_epi16(128)), 8);
+    return _mm256_add_epi16(c, _mm256_set1_epi16(128));
+}
+
+// Packs 16 lanes into bytes and returns them in pixel order
+__attribute__((target("avx2")))
+static inline __m128i pack16(__m256i x) {
+    __m256i packed = _mm256_packus_epi16(x, _mm256_setzero_si256());
+    return _mm256_castsi256_si128(_mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0)));
+}
+
+// Converts the columns in steps of 16 and returns where the other paths have to continue
+__attribute__((target("avx2")))
+static size_t convert_row_pair_avx2(const uint8_t *src0, const uint8_t *src1, uint8_t *dst_y0, uint8_t *dst_y1,
+                                    uint8_t *dst_u, uint8_t *dst_v, size_t width, bool has_second_row) {
+    size_t x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m256i r0, g0, b0, r1, g1, b1;
+        deinterleave16(src0 + 4*x, &r0, &g0, &b0);
+        deinterleave16(src1 + 4*x, &r1, &g1, &b1);
+
+        _mm_storeu_si128((__m128i*)(dst_y0 + x), pack16(luma16(r0, g0, b0)));
+        if (has_second_row) {
+            _mm_storeu_si128((__m128i*)(dst_y1 + x), pack16(luma16(r1, g1, b1)));
+        }
+
+        __m256i r = average2x2_16(r0, r1);
+        __m256i g = average2x2_16(g0, g1);
+        __m256i b = average2x2_16(b0, b1);
+        _mm_storel_epi64((__m128i*)(dst_u + x/2), pack16(chroma16(r, g, b, -38, -74, 112)));
+        _mm_storel_epi64((__m128i*)(dst_v + x/2), pack16(chroma16(r, g, b, 112, -94, -18)));
+    }
+    return x;
+}
+#endif
+
+static void convert_row_pair(const uint8_t *src0, const uint8_t *src1, uint8_t *dst_y0, uint8_t *dst_y1,
+                             uint8_t *dst_u, uint8_t *dst_v, size_t width, bool has_second_row, bool avx2) {
+    size_t x = 0;
+
+#if defined(YUV_X86)
+    if (avx2) x = convert_row_pair_avx2(src0, src1, dst_y0, dst_y1, dst_u, dst_v, width, has_second_row);
+#else
+    (void) avx2;
+#endif
+
+#if defined(__SSE2__)
+    for (; x + 8 <= width; x += 8) {
+        __m128i r0, g0, b0, r1, g1, b1;
+        deinterleave8(src0 + 4*x, &r0, &g0, &b0);
+        deinterleave8(src1 + 4*x, &r1, &g1, &b1);
+
+        _mm_storel_epi64((__m128i*)(dst_y0 + x), _mm_packus_epi16(luma8(r0, g0, b0), _mm_setzero_si128()));
+        if (has_second_row) {
+            _mm_storel_epi64((__m128i*)(dst_y1 + x), _mm_packus_epi16(luma8(r1, g1, b1), _mm_setzero_si128()));
+        }
+
+        __m128i r = average2x2(r0, r1);
+        __m128i g = average2x2(g0, g1);
+        __m128i b = average2x2(b0, b1);
+        int u = _mm_cvtsi128_si32(_mm_packus_epi16(chroma8(r, g, b, -38, -74, 112), _mm_setzero_si128()));
+        int v = _mm_cvtsi128_si32(_mm_packus_epi16(chroma8(r, g, b, 112, -94, -18), _mm_setzero_si128()));
+        memcpy(dst_u + x/2, &u, 4);
+        memcpy(dst_v + x/2, &v, 4);
+    }
+#endif
+
+    for (; x < width; x += 2) {
+        size_t x1 = x + 1 < width ? x + 1 : x;
+        const uint8_t *p[4] = { src0 + 4*x, src0 + 4*x1, src1 + 4*x, src1 + 4*x1 };
+
+        dst_y0[x] = luma(p[0][0], p[0][1], p[0][2]);
+        if (x1 != x) dst_y0[x1] = luma(p[1][0], p[1][1], p[1][2]);
+        if (has_second_row) {
+            dst_y1[x] = luma(p[2][0], p[2][1], p[2][2]);
+            if (x1 != x) dst_y1[x1] = luma(p[3][0], p[3][1], p[3][2]);
+        }
+
+        int r = (p[0][0] + p[1][0] + p[2][0] + p[3][0] + 2) >> 2;
+        int g = (p[0][1] + p[1][1] + p[2][1] + p[3][1] + 2) >> 2;
+        int b = (p[0][2] + p[1][2] + p[2][2] + p[3][2] + 2) >> 2;
+        dst_u[x/2] = chroma_u(r, g, b);
+        dst_v[x/2] = chroma_v(r, g, b);
+    }
+}
+
+// Converts the row pairs [begin, end), so every band starts on an even row
+static void convert_band(void *user, size_t begin, size_t end, size_t band) {
+    (void) band;
+    YUV_Frame *frame = user;
+    size_t width = frame->width;
+    size_t height = frame->height;
+    size_t stride = 4 * width;
+    size_t chroma_width = (width + 1) / 2;
+
+    uint8_t *plane_y = frame->yuv;
+    uint8_t *plane_u = plane_y + width * height;
+    uint8_t *plane_v = plane_u + chroma_width * ((height + 1) / 2);
+
+    for (size_t y = 2 * begin; y < 2 * end; y += 2) {
+        bool has_second_row = y + 1 < height;
+        size_t y1 = has_second_row ? y + 1 : y;
+        size_t src_y0 = frame->flipped ? height - 1 - y : y;
+        size_t src_y1 = frame->flipped ? height - 1 - y1 : y1;
+
+        convert_row_pair(frame->rgba + src_y0 * stride, frame->rgba + src_y1 * stride,
+                         plane_y + y * width, plane_y + y1 * width,
+                         plane_u + (y/2) * chroma_width, plane_v + (y/2) * chroma_width,
+                         width, has_second_row, frame->avx2);
+    }
+}
+
+void rgba_to_yuv420p(const uint8_t *rgba, size_t width, size_t height, bool flipped, uint8_t *yuv, Thread_Pool *pool) {
+    YUV_Frame frame = {
+        .rgba = rgba,
+        .width = width,
+        .height = height,
+        .flipped = flipped,
+        .yuv = yuv,
+    };
+#if defined(YUV_X86)
+    __builtin_cpu_init();
+    frame.avx2 = __builtin_cpu_supports("avx2");
+#endif
+    thread_pool_run(pool, convert_band, &frame, (height + 1) / 2);
+}
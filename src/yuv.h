@@ -0,0 +1,21 @@
+#ifndef YUV_H_
+#define YUV_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "thread_pool.h"
+
+// Size in bytes of a planar YUV 4:2:0 (I420) frame: full resolution Y plane
+// followed by the quarter resolution U and V planes.
+size_t yuv420p_size(size_t width, size_t height);
+
+// Converts an RGBA8 frame into I420 with BT.601 limited range coefficients,
+// matching what ffmpeg's swscale produces for `-pix_fmt yuv420p`. The rows are
+// split into bands converted on `pool` (NULL converts on the calling thread).
+// If `flipped` the source is stored bottom row first and the output comes out
+// top-down.
+void rgba_to_yuv420p(const uint8_t *rgba, size_t width, size_t height, bool flipped, uint8_t *yuv, Thread_Pool *pool);
+
+#endif // YUV_H_